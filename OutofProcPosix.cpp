@@ -0,0 +1,372 @@
+/*
+* posix entrypoint, runs the same kill/respawn churn as the win32 build but without a window system,
+* children render headless through egl
+* */
+#include "stdafx.h"
+#include "glad.h"
+#include "logging.h"
+#include "settings.h"
+#include "async_log.h"
+#include "frame_scheduler.h"
+#include "process_supervisor.h"
+#include "reclaim_monitor.h"
+#include "headless_egl.h"
+#include "memory_probe.h"
+#include "respawn_scheduler.h"
+#include "scene.h"
+#include "shared_metrics.h"
+#include "shared_textures.h"
+#include "sweep.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+INITIALIZE_EASYLOGGINGPP
+
+// ------------------------------
+// Global Variables
+
+volatile sig_atomic_t	bClosing = 0;
+thread_local std::string	_instance_name;
+int						_instance_id = -1;
+bool					IsMaster() { return kInstance_slot < 0; }
+
+static void OnTerminate(int)
+{
+	bClosing = 1;
+}
+
+// ------------------------------
+// child: render into an offscreen framebuffer until killed, or on a render thread
+// of the master (--threads) until stop is set
+
+static int RunChild(const std::atomic<bool>* stop = nullptr)
+{
+	OpenMetricsSlot(kInstance_slot);
+	int64_t context_start = MonotonicNs();
+	bool context = InitHeadlessContext(200, 200);
+	RecordPhase(MetricsPhase::Context, MonotonicNs() - context_start);
+	TraceEvent("context", context_start, MonotonicNs());
+	if (!context || !InitScene())
+	{
+		DestroyHeadlessContext();
+		return -1;
+	}
+
+	size_t frames = 0;
+	bool first_frame = true;
+	std::chrono::steady_clock::time_point report_point = std::chrono::steady_clock::now();
+	FrameScheduler scheduler(kTarget_fps);
+	while (!bClosing && !(stop && stop->load(std::memory_order_relaxed)))
+	{
+		if (!scheduler.Wait())
+		{
+			continue;	// interrupted, most likely by SIGTERM
+		}
+		DrawScene();
+		int64_t present_start = MonotonicNs();
+		PresentHeadless();
+		frames++;
+		if (first_frame)
+		{
+			first_frame = false;
+			TraceEvent("first swap", present_start, MonotonicNs());
+			NotifyFirstFrame();
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - report_point).count();
+		if (elapsed >= 5.0)
+		{
+			SceneStats stats = TakeSceneStats();
+			LOG(INFO) << "[" << _instance_name << "] " << frames << " frames in " << elapsed << " s (" << frames / elapsed << " fps), "
+				<< stats.draws / elapsed << " draws/s, " << NsToMs(stats.cpu_ns) / std::max<size_t>(stats.frames, 1) << " ms cpu/frame, "
+				<< NsToMs(stats.select_ns) * 1000 / std::max<size_t>(stats.frames, 1) << " us texture select/frame ("
+				<< (kInstanced ? "instanced" : "naive") << (kUbo ? " + ubo" : "") << ", " << kObject_count << " objects, "
+				<< TextureModeName(SceneTextureMode()) << " textures)";
+			FrameSchedulerStats pacing = scheduler.TakeStats();
+			LOG(INFO) << "[" << _instance_name << "] " << "pacing: " << (scheduler.Fps() > 0 ? std::to_string(scheduler.Fps()) + " fps target, " : "unlimited, ")
+				<< pacing.missed << " missed deadlines (worst " << NsToMs(pacing.worst_late_ns) << " ms late), "
+				<< NsToMs(pacing.oversleep_ns) * 1000 / std::max<size_t>(pacing.frames, 1) << " us mean oversleep";
+			frames = 0;
+			report_point = now;
+		}
+	}
+
+	DestroyHeadlessContext();
+	return 0;
+}
+
+// ------------------------------
+// master: spawn, wait for the first frames, kill on the schedule of kRespawn_policy
+
+static const int64_t kMemorySampleNs = 100000000ll;	// 100 ms
+
+// driver memory once the churn reached its steady state, one respawn period after the start
+struct ChurnResult
+{
+	RespawnPolicy		policy = RespawnPolicy::Burst;
+	unsigned long long	seed = 0;				// the one drawn when kRespawn_seed is 0
+	size_t				kills = 0;
+	double				memory_mb = 0;			// above the level before the first spawn, mean of the samples
+	double				memory_peak_mb = 0;
+};
+
+// run_ns 0 runs until SIGINT/SIGTERM
+static ChurnResult RunChurn(ProcessSupervisor& supervisor, int64_t run_ns)
+{
+	RespawnScheduler respawn(kRespawn_policy, kRespawn_time_in_seconds, kMax_num_process_count, kRespawn_seed);
+	MemoryProbe memory;
+	bool sampling = memory.Init();
+	int64_t idle = memory.Sample();
+	LOG(INFO) << "[" << _instance_name << "] " << "respawn: " << RespawnPolicyName(respawn.Policy()) << " every " << kRespawn_time_in_seconds
+		<< " s, seed " << respawn.Seed() << ", driver memory from " << memory.SourceName();
+
+	int64_t start_ns = MonotonicNs();
+	int64_t run_until = start_ns + run_ns;
+	int64_t steady_ns = start_ns + (int64_t)kRespawn_time_in_seconds * 1000000000ll;
+	int64_t report_ns = start_ns;
+	int64_t sample_ns = 0;
+	size_t samples = 0, report_kills = 0;
+	int64_t memory_sum = 0, memory_peak = 0;
+
+	// Main loop:
+	while (!bClosing && (run_ns == 0 || MonotonicNs() < run_until))
+	{
+		// launch every missing child at once, then wait for their first frames together
+		while ((int)supervisor.Count() < kMax_num_process_count && supervisor.Spawn() >= 0)
+		{
+		}
+
+		int remaining = (int)std::max<int64_t>((respawn.NextKillNs() - MonotonicNs()) / 1000000, 0);
+		if (supervisor.Pending() > 0)
+		{
+			supervisor.WaitReady(remaining);
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(remaining, 10)));
+		}
+
+		int64_t now = MonotonicNs();
+		if (sampling && now >= steady_ns && now >= sample_ns)
+		{
+			int64_t used = memory.Sample() - idle;
+			memory_sum += used;
+			memory_peak = samples++ == 0 ? used : std::max(memory_peak, used);
+			sample_ns = now + kMemorySampleNs;
+		}
+		if (now - report_ns >= 5000000000ll)
+		{
+			ReportMetrics();
+			LOG(INFO) << "[" << _instance_name << "] " << "respawn: " << respawn.Kills() - report_kills << " kills (" << RespawnPolicyName(respawn.Policy())
+				<< "), driver memory " << (memory.Sample() - idle) / (1024.0 * 1024.0) << "mb above idle";
+			report_ns = now;
+			report_kills = respawn.Kills();
+		}
+		supervisor.KillSlots(respawn.Due(now, supervisor.Slots()), 2000);
+	}
+
+	ChurnResult result;
+	result.policy = respawn.Policy();
+	result.seed = respawn.Seed();
+	result.kills = respawn.Kills();
+	result.memory_mb = samples ? memory_sum / (double)samples / (1024 * 1024) : 0;
+	result.memory_peak_mb = memory_peak / (1024.0 * 1024.0);
+	return result;
+}
+
+// child processes, or render threads in this process
+static std::unique_ptr<ProcessSupervisor> CreateSupervisor(int argc, char** argv)
+{
+	if (kThreads)
+	{
+		return ProcessSupervisor::CreateThreads([](const std::atomic<bool>& stop) { return RunChild(&stop); });
+	}
+	return ProcessSupervisor::Create(argc, argv);
+}
+
+static int RunMaster(int argc, char** argv)
+{
+	// before the first spawn, the zygote maps the segment too
+	if (kShared_textures) CreateSharedTextures();
+	CreateSharedMetrics();
+	std::unique_ptr<ProcessSupervisor> supervisor = CreateSupervisor(argc, argv);
+
+	// a context of our own makes the gl memory counters available, the idle level is
+	// taken before the first child exists
+	ReclaimMonitor reclaim;
+	bool reclaim_context = false;
+	if (kReclaim)
+	{
+		reclaim_context = InitHeadlessContext(16, 16);
+		if (reclaim.Init()) supervisor->SetReclaimMonitor(&reclaim);
+	}
+
+	// the run's totals, what a sweep row holds
+	ChurnResult churn = RunChurn(*supervisor, 0);
+	ReportMetrics();
+	LOG(INFO) << "[" << _instance_name << "] " << "respawn: " << churn.kills << " kills (" << RespawnPolicyName(churn.policy) << ", seed " << churn.seed
+		<< "), driver memory " << churn.memory_mb << "mb mean, " << churn.memory_peak_mb << "mb peak above idle";
+
+	supervisor->KillAll(2000, true);
+	supervisor.reset();
+	if (reclaim_context) DestroyHeadlessContext();
+	DestroySharedTextures();
+	DestroySharedMetrics();
+	return 0;
+}
+
+// ------------------------------
+// master (--sweep): the churn above for kSweep_seconds per configuration, the
+// settings of each parsed again from the command line with its own appended
+
+static int RunSweep(int argc, char** argv)
+{
+	std::vector<SweepConfig> configs;
+	if (!ParseSweep(kSweep.c_str(), configs))
+	{
+		return -1;
+	}
+	const std::string report = kSweep_report;
+	const int64_t run_ns = (int64_t)kSweep_seconds * 1000000000ll;
+
+	// the driver under test goes into every row, the same context serves the reclaim monitor
+	bool context = InitHeadlessContext(16, 16);
+	std::string driver = context ? std::string((const char*)glGetString(GL_RENDERER)) + " / " + (const char*)glGetString(GL_VERSION) : "unknown";
+	LOG(INFO) << "[" << _instance_name << "] " << "sweep: " << configs.size() << " configurations, " << kSweep_seconds << " s each on " << driver;
+
+	std::vector<SweepResult> results;
+	for (size_t i = 0; i < configs.size() && !bClosing; ++i)
+	{
+		const SweepConfig& config = configs[i];
+		std::vector<std::string> arguments = SweepArguments(argc, argv, config);
+		std::vector<char*> config_argv;
+		for (std::string& argument : arguments) config_argv.push_back(&argument[0]);
+		config_argv.push_back(nullptr);
+		if (!ParseSettings((int)arguments.size() - 1, (const char**)&config_argv[1]))
+		{
+			break;
+		}
+		LOG(INFO) << "[" << _instance_name << "] " << "sweep " << i + 1 << "/" << configs.size() << ": " << kMax_num_process_count << " children, "
+			<< kNum_Textures << " textures of " << kTexture_width << "x" << kTexture_width << ", respawn every " << kRespawn_time_in_seconds << " s ("
+			<< RespawnPolicyName(kRespawn_policy) << ")";
+
+		if (kShared_textures) CreateSharedTextures();
+		CreateSharedMetrics();
+		std::unique_ptr<ProcessSupervisor> supervisor = CreateSupervisor((int)arguments.size(), config_argv.data());
+		ReclaimMonitor reclaim;
+		if (kReclaim && context && reclaim.Init()) supervisor->SetReclaimMonitor(&reclaim);
+
+		int64_t start_ns = MonotonicNs();
+		ChurnResult churn = RunChurn(*supervisor, run_ns);
+		supervisor->KillAll(2000);
+
+		SweepResult result;
+		result.config = config;
+		result.seconds = (MonotonicNs() - start_ns) / 1e9;
+		const SupervisorStats& stats = supervisor->Stats();
+		result.spawned = stats.spawned;
+		result.spawn_failures = stats.spawn_failures;
+		result.spawn_ms = stats.total_spawn_ms / std::max<size_t>(stats.spawned, 1);
+		result.ready = stats.ready;
+		result.ready_failures = stats.ready_failures;
+		result.first_frame_ms = stats.total_ready_ms / std::max<size_t>(stats.ready, 1);
+		result.reaped = stats.reaped;
+		result.reap_ms = stats.total_reap_ms / std::max<size_t>(stats.reaped, 1);
+		result.wave_ms = stats.total_wave_ms / std::max<size_t>(stats.waves, 1);
+		result.wave_worst_ms = stats.worst_wave_ms;
+		result.kills = churn.kills;
+		result.memory_mb = churn.memory_mb;
+		result.memory_peak_mb = churn.memory_peak_mb;
+		MetricsTotals totals = ReadMetricsTotals();
+		result.fps = totals.child_seconds > 0 ? totals.frames / totals.child_seconds : 0;
+		const ReclaimStats& reclaimed = reclaim.Stats();
+		result.reclaim_kills = reclaimed.kills;
+		result.reclaim_ms = reclaimed.total_latency_ms / std::max<size_t>(reclaimed.waves, 1);
+		result.reclaim_worst_ms = reclaimed.worst_latency_ms;
+		result.leaked_mb = reclaimed.total_leaked / (1024.0 * 1024.0);
+		results.push_back(result);
+
+		supervisor.reset();
+		DestroySharedTextures();
+		DestroySharedMetrics();
+
+		// rewritten after every configuration, an interrupted sweep keeps what it measured
+		WriteSweepReport(report, driver, results);
+		LOG(INFO) << "[" << _instance_name << "] " << "sweep " << i + 1 << "/" << configs.size() << ": " << result.spawn_ms << " ms spawn, "
+			<< result.first_frame_ms << " ms to first frame, " << result.fps << " fps, " << result.reap_ms << " ms reap, " << result.wave_ms << " ms kill wave, " << result.memory_mb << "mb driver memory"
+			<< (result.reclaim_kills ? ", " + std::to_string(result.reclaim_ms) + " ms reclaim" : "") << ", written to " << report;
+	}
+
+	if (context) DestroyHeadlessContext();
+	return 0;
+}
+
+// ------------------------------
+// Main Entrypoint
+
+int main(int argc, char** argv)
+{
+	if (!ParseSettings(argc - 1, (const char**)&argv[1]))	// skip first argument (module path)
+	{
+		return -1;
+	}
+
+	struct sigaction sa = {};
+	sa.sa_handler = OnTerminate;
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	if (kZygote_fd >= 0)
+	{
+		// everything done here is inherited by every child forked below
+		_instance_name = "zygote";
+		LOG(INFO) << "[" << _instance_name << "] " << " started.";
+		PreloadHeadless();
+		PrepareScene();
+		MapSharedMetrics();
+		if (!ServeZygote(kZygote_fd))
+		{
+			LOG(INFO) << "[" << _instance_name << "] " << " exiting.";
+			return 0;
+		}
+	}
+
+	_instance_id = kInstance_slot;
+	_instance_name = IsMaster() ? "master" : std::to_string(_instance_id);
+	int session = IsMaster() ? (int)::getpid() : kSession_id;
+	if (kAsync_log) StartAsyncLog(session, _instance_name);
+	if (kTrace) StartTrace(session, _instance_name);
+	LOG(INFO) << "[" << _instance_name << "] " << " started.";
+
+	if (!IsMaster())
+	{
+		int ret = RunChild();
+		LOG(INFO) << "[" << _instance_name << "] " << " exiting.";
+		StopTrace();
+		StopAsyncLog();
+		return ret;
+	}
+
+	int ret = kSweep.empty() ? RunMaster(argc, argv) : RunSweep(argc, argv);
+	LOG(INFO) << "[" << _instance_name << "] " << " exiting.";
+	StopTrace();
+	StopAsyncLog();
+	if (kAsync_log)
+	{
+		std::string merged = "logs/outofproc." + std::to_string(session) + ".merged.log";
+		size_t lines = MergeAsyncLogs(session, merged);
+		LOG(INFO) << "[" << _instance_name << "] " << "merged " << lines << " log lines into " << merged;
+	}
+	return ret;
+}
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "async_log.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static const size_t kRecords = 4096;		// ring slots, 1 mb per process
+static const size_t kRecordText = 236;
+static const size_t kMaxRecordsPerLine = kRecords / 8;	// longer lines are cut
+static const int kDrainIntervalMs = 5;
+
+// ------------------------------
+// ring: bounded multi producer single consumer queue. every slot carries the ring
+// position it's free for (position) or holds a line for (position + 1), a producer
+// reserves all the slots of its line with one cas on the head. the consumer frees
+// slots in order, so once the last slot of a reservation is free all of them are.
+
+struct LogRecord
+{
+	std::atomic<uint64_t>	sequence;
+	int64_t					ns;
+	uint16_t				length;
+	uint8_t					more;		// the line goes on in the next slot
+	char					text[kRecordText];
+};
+static_assert(sizeof(LogRecord) == 256, "a ring slot is meant to be 4 cache lines");
+
+static std::unique_ptr<LogRecord[]>	_ring;
+static std::atomic<uint64_t>		_head(0);
+static uint64_t						_tail = 0;			// drain thread only
+static std::atomic<size_t>			_dropped(0);
+static std::atomic<bool>			_running(false);
+static std::thread					_drain;
+static FILE*						_file = nullptr;
+
+static void Push(int64_t ns, const char* text, size_t length)
+{
+	size_t count = std::min(std::max<size_t>((length + kRecordText - 1) / kRecordText, 1), kMaxRecordsPerLine);
+	length = std::min(length, count * kRecordText);
+
+	uint64_t position = _head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		uint64_t last = position + count - 1;
+		uint64_t sequence = _ring[last % kRecords].sequence.load(std::memory_order_acquire);
+		if (sequence == last)
+		{
+			if (_head.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) break;
+		}
+		else if (sequence < last)
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);	// full, never wait on the disk
+			return;
+		}
+		else
+		{
+			position = _head.load(std::memory_order_relaxed);
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		LogRecord& record = _ring[(position + i) % kRecords];
+		size_t part = std::min(length - i * kRecordText, kRecordText);
+		record.ns = ns;
+		record.length = (uint16_t)part;
+		record.more = i + 1 < count;
+		memcpy(record.text, text + i * kRecordText, part);
+		record.sequence.store(position + i + 1, std::memory_order_release);
+	}
+}
+
+// everything published so far, appended to batch as "<ns> <line>\n"
+static void Drain(std::string& batch)
+{
+	static bool continued = false;
+	for (;;)
+	{
+		LogRecord& record = _ring[_tail % kRecords];
+		if (record.sequence.load(std::memory_order_acquire) != _tail + 1) break;
+
+		if (!continued)
+		{
+			char stamp[24];
+			snprintf(stamp, sizeof(stamp), "%020lld ", (long long)record.ns);
+			batch += stamp;
+		}
+		batch.append(record.text, record.length);
+		continued = record.more != 0;
+		if (!continued) batch += '\n';
+
+		record.sequence.store(_tail + kRecords, std::memory_order_release);
+		_tail++;
+	}
+}
+
+static void DrainLoop()
+{
+	std::string batch;
+	bool running = true;
+	while (running)
+	{
+		running = _running.load(std::memory_order_acquire);
+		if (running) std::this_thread::sleep_for(std::chrono::milliseconds(kDrainIntervalMs));
+
+		Drain(batch);
+		size_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0)
+		{
+			char note[96];
+			snprintf(note, sizeof(note), "%020lld (%zu log lines dropped, the ring was full)\n", (long long)MonotonicNs(), dropped);
+			batch += note;
+		}
+		if (!batch.empty())
+		{
+			fwrite(batch.data(), 1, batch.size(), _file);
+			fflush(_file);
+			batch.clear();
+		}
+	}
+}
+
+// ------------------------------
+// easylogging++ side
+
+class AsyncLogSink : public el::LogDispatchCallback
+{
+protected:
+	void handle(const el::LogDispatchData* data) override
+	{
+		if (data->dispatchAction() != el::base::DispatchAction::NormalLog || !_running.load(std::memory_order_relaxed)) return;
+		el::base::type::string_t line = data->logMessage()->logger()->logBuilder()->build(data->logMessage(), false);
+		Push(MonotonicNs(), line.data(), line.size());
+	}
+};
+
+static int ThisProcessId()
+{
+#ifdef _WIN32
+	return (int)::GetCurrentProcessId();
+#else
+	return (int)::getpid();
+#endif
+}
+
+static std::string FilePrefix(int session)
+{
+	return "outofproc." + std::to_string(session) + ".";
+}
+
+bool StartAsyncLog(int session, const std::string& name)
+{
+	if (_running.load()) return true;
+
+	std::error_code ec;
+	std::filesystem::create_directories("logs", ec);
+	std::filesystem::path path = std::filesystem::path("logs") / (FilePrefix(session) + name + "." + std::to_string(ThisProcessId()) + ".log");
+	_file = fopen(path.string().c_str(), "ab");
+	if (_file == nullptr)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "async log: can't open " << path.string() << ", logging to the shared file";
+		return false;
+	}
+
+	_ring.reset(new LogRecord[kRecords]);
+	for (size_t i = 0; i < kRecords; ++i) _ring[i].sequence.store(i, std::memory_order_relaxed);
+	_head.store(0);
+	_tail = 0;
+	_running.store(true, std::memory_order_release);
+	_drain = std::thread(DrainLoop);
+
+	el::Loggers::reconfigureAllLoggers(el::ConfigurationType::ToFile, "false");
+	el::Helpers::installLogDispatchCallback<AsyncLogSink>("AsyncLogSink");
+	return true;
+}
+
+void StopAsyncLog()
+{
+	if (!_running.load()) return;
+
+	el::Helpers::uninstallLogDispatchCallback<AsyncLogSink>("AsyncLogSink");
+	el::Loggers::reconfigureAllLoggers(el::ConfigurationType::ToFile, "true");
+	_running.store(false, std::memory_order_release);
+	_drain.join();
+	fclose(_file);
+	_file = nullptr;
+	_ring.reset();
+}
+
+// ------------------------------
+// merge
+
+size_t MergeAsyncLogs(int session, const std::string& path)
+{
+	// lines without a timestamp belong to the line before them (multi line messages)
+	std::vector<std::pair<int64_t, std::string>> lines;
+	std::string prefix = FilePrefix(session);
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator("logs", ec))
+	{
+		std::string name = entry.path().filename().string();
+		if (name.compare(0, prefix.size(), prefix) != 0 || entry.path().filename() == std::filesystem::path(path).filename()) continue;
+
+		std::ifstream file(entry.path());
+		std::string line;
+		while (std::getline(file, line))
+		{
+			bool stamped = line.size() > 21 && line[20] == ' ' && std::all_of(line.begin(), line.begin() + 20, [](char c) { return c >= '0' && c <= '9'; });
+			if (stamped) lines.emplace_back(strtoll(line.c_str(), nullptr, 10), line);
+			else if (!lines.empty()) lines.back().second += "\n" + line;
+		}
+	}
+
+	// stable, the lines of one process keep their order on equal timestamps
+	std::stable_sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	std::ofstream merged(path, std::ios::trunc);
+	for (const auto& line : lines) merged << line.second << "\n";
+	return merged ? lines.size() : 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// ------------------------------
+// async log sink (--async-log): every process logs into its own file instead of
+// all of them appending to logs/outofproc.log. a log call only copies the formatted
+// line into a lock-free ring, a background thread writes whatever piled up every
+// few milliseconds. every line starts with the zero padded MonotonicNs() of the
+// call, which is machine wide, so the master can merge the files of a session into
+// one ordered timeline. a child killed outright loses the last few ms of lines.
+
+// route easylogging++ into logs/outofproc.<session>.<name>.<pid>.log, session is the
+// master's process id
+bool	StartAsyncLog(int session, const std::string& name);
+
+// write what's left and hand the file output back to easylogging++
+void	StopAsyncLog();
+
+// master: merge every file of session (the master's stopped already) into path,
+// ordered by timestamp. returns the number of lines written
+size_t	MergeAsyncLogs(int session, const std::string& path);
@@ -0,0 +1,225 @@
+/*
+* cpu hot paths in ns/op (and bytes/s where an op has a size): nscanf on obj lines,
+* loadobj, memset32, makechecker, the child's ParseSettings (option::Options::Parse
+* and the reads after it) and the glm matrix chain of a frame.
+* every sample runs a batch of ops calibrated to take at least 10 ms, the median of
+* the samples is reported along with its median absolute deviation, anything above
+* 5% is marked noisy and worth running again on a quieter machine.
+*
+*	bench_hot_paths [name filter] [samples (15)]
+* */
+#include "stdafx.h"
+#include "logging.h"
+#include "scene.h"
+#include "settings.h"
+#include "timing.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+thread_local std::string _instance_name = "bench";
+
+static const int64_t kMinSampleNs = 10000000;	// 10 ms
+static const double kNoisyDeviation = 0.05;
+
+// results the compiler can't prove unused
+static volatile float g_sink;
+
+// ------------------------------
+// harness
+
+struct Measurement
+{
+	double	ns_per_op;
+	double	deviation;	// median absolute deviation / median
+};
+
+// fn(ops) runs ops operations, batch size doubles until a batch takes kMinSampleNs
+static Measurement Measure(int samples, const std::function<void(size_t)>& fn)
+{
+	size_t ops = 1;
+	for (;;)
+	{
+		int64_t start = MonotonicNs();
+		fn(ops);
+		if (MonotonicNs() - start >= kMinSampleNs || ops >= (1ull << 30)) break;
+		ops *= 2;
+	}
+
+	std::vector<double> ns;
+	for (int i = 0; i < samples; ++i)
+	{
+		int64_t start = MonotonicNs();
+		fn(ops);
+		ns.push_back((double)(MonotonicNs() - start) / ops);
+	}
+	std::sort(ns.begin(), ns.end());
+	double median = ns[ns.size() / 2];
+	std::vector<double> deviations;
+	for (double v : ns) deviations.push_back(std::fabs(v - median));
+	std::sort(deviations.begin(), deviations.end());
+	return { median, median > 0 ? deviations[deviations.size() / 2] / median : 0 };
+}
+
+static void Report(const char* name, const Measurement& m, size_t bytes_per_op)
+{
+	char rate[32] = "";
+	if (bytes_per_op > 0) snprintf(rate, sizeof(rate), "%9.1f MB/s", bytes_per_op / m.ns_per_op * 1e3);
+	printf("%-26s %14.1f ns/op %14s  +-%4.1f%%%s\n", name, m.ns_per_op, rate, m.deviation * 100, m.deviation > kNoisyDeviation ? "  noisy" : "");
+}
+
+// ------------------------------
+// inputs
+
+// count copies of line, for nscanf to walk through
+static std::string Lines(const char* line, size_t count)
+{
+	std::string text;
+	for (size_t i = 0; i < count; ++i) text += line;
+	return text;
+}
+
+// a uv sphere of triangles with v/vt/vn corners, the only form loadobj reads
+static std::string Sphere(int segments)
+{
+	std::string obj;
+	char line[160];
+	for (int i = 0; i <= segments; ++i)
+	{
+		float theta = 3.14159265f * i / segments;
+		for (int j = 0; j < segments; ++j)
+		{
+			float phi = 6.2831853f * j / segments;
+			float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+			obj.append(line, snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, z, (float)j / segments, (float)i / segments, x, y, z));
+		}
+	}
+	for (int i = 0; i < segments; ++i)
+	{
+		for (int j = 0; j < segments; ++j)
+		{
+			int a = i * segments + j + 1, b = i * segments + (j + 1) % segments + 1, c = a + segments, d = b + segments;
+			obj.append(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+				a, a, a, b, b, b, d, d, d, a, a, a, d, d, d, c, c, c));
+		}
+	}
+	return obj;
+}
+
+// ------------------------------
+// cases
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+	int samples = argc > 2 ? atoi(argv[2]) : 15;
+	if (samples < 1)
+	{
+		printf("usage: bench_hot_paths [name filter] [samples]\n");
+		return -1;
+	}
+	printf("median of %d samples, each at least %lld ms\n\n", samples, (long long)(kMinSampleNs / 1000000));
+
+	auto run = [&](const char* name, size_t bytes_per_op, const std::function<void(size_t)>& fn)
+	{
+		if (strstr(name, filter) == nullptr) return;
+		Report(name, Measure(samples, fn), bytes_per_op);
+	};
+
+	// one line per op, wrapping around at the end of the block
+	const char* vertex_line = "0.707107 -0.500000 0.353553\n";
+	const char* face_line = "1021/1021/1021 1022/1022/1022 1086/1086/1086\n";
+	for (const char* line : { vertex_line, face_line })
+	{
+		const size_t lines = 1024;
+		std::string block = Lines(line, lines);
+		bool face = line == face_line;
+		run(face ? "nscanf face" : "nscanf vertex", strlen(line), [&](size_t ops)
+		{
+			char* rp = &block[0];
+			size_t left = lines;
+			float f[3];
+			int d[9];
+			for (size_t i = 0; i < ops; ++i)
+			{
+				if (left-- == 0)
+				{
+					rp = &block[0];
+					left = lines - 1;
+				}
+				if (face) nscanf(rp, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &d[0], &d[1], &d[2], &d[3], &d[4], &d[5], &d[6], &d[7], &d[8]);
+				else nscanf(rp, "%f %f %f\n", &f[0], &f[1], &f[2]);
+			}
+			g_sink = face ? (float)d[8] : f[2];
+		});
+	}
+
+	std::string sphere = Sphere(64);
+	run("loadobj (64x64 sphere)", sphere.size(), [&](size_t ops)
+	{
+		for (size_t i = 0; i < ops; ++i) g_sink = (float)loadobj(sphere.c_str())->vertices.size();
+	});
+
+	const size_t wh = 1024;
+	std::unique_ptr<unsigned int[]> pixels(new unsigned int[wh * wh]);
+	run("memset32 (1024x1024)", wh * wh * 4, [&](size_t ops)
+	{
+		for (size_t i = 0; i < ops; ++i) memset32(pixels.get(), 0x3366ccff + (uint32_t)i, wh * wh * 4);
+		g_sink = (float)pixels[wh * wh - 1];
+	});
+	run("makechecker (1024x1024)", wh * wh * 4, [&](size_t ops)
+	{
+		for (size_t i = 0; i < ops; ++i) makechecker(pixels.get(), wh);
+		g_sink = (float)pixels[wh * wh - 1];
+	});
+
+	// what every child parses: the master's options plus what the supervisor appends
+	const char* child_args[] = { "--count", "5", "--textures", "10", "--size", "4096", "--fps", "60",
+		"--instance", "3", "--session", "4242", "--spawned-at", "123456789012345", "--freed-at", "123456789000000", "--ready", "7", nullptr };
+	const int child_argc = (int)(sizeof(child_args) / sizeof(child_args[0])) - 1;
+	size_t child_bytes = 0;
+	for (int i = 0; i < child_argc; ++i) child_bytes += strlen(child_args[i]) + 1;
+	run("ParseSettings (child)", child_bytes, [&](size_t ops)
+	{
+		for (size_t i = 0; i < ops; ++i) ParseSettings(child_argc, child_args);
+		g_sink = (float)kInstance_slot;
+	});
+
+	// SubmitFrame: projection and view once per frame, then a model matrix per object
+	run("glm frame (proj*view)", 0, [&](size_t ops)
+	{
+		for (size_t i = 0; i < ops; ++i)
+		{
+			float scale = 1.0f + (i & 7) * 0.125f;
+			glm::mat4 Projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f * scale);
+			glm::mat4 View = glm::lookAt(glm::vec3(4, 3, 3) * scale, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+			glm::mat4 vp = Projection * View;
+			g_sink = vp[3][2];
+		}
+	});
+	run("glm object (model*vp)", 0, [&](size_t ops)
+	{
+		glm::mat4 vp = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(4, 3, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+		for (size_t i = 0; i < ops; ++i)
+		{
+			int object = (int)(i & 63);
+			glm::vec3 position((object % 8 - 3.5f) * 3.0f, 0.0f, (object / 8 - 3.5f) * 3.0f);
+			glm::mat4 Model = glm::rotate(glm::translate(glm::mat4(1), position), i * 0.02f + object * 0.7f, glm::vec3(0.5f, 1.00f, 0.50f));
+			glm::mat4 mvp = vp * Model;
+			g_sink = mvp[3][2];
+		}
+	});
+	return 0;
+}
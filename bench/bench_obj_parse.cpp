@@ -0,0 +1,152 @@
+/*
+* obj parsing throughput: the original nscanf based loadobj against ReadObj on
+* 1..N threads, on an obj file or a generated sphere (triangles with v/vt/vn
+* corners, the only form loadobj reads).
+*
+*	bench_obj_parse [file.obj | sphere segments (1000)] [iterations (5)]
+* */
+#include "stdafx.h"
+#include "logging.h"
+#include "obj_reader.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+thread_local std::string _instance_name = "bench";
+
+// median of iterations runs after one warm-up run
+static double MedianMs(int iterations, const std::function<void()>& fn)
+{
+	fn();
+	std::vector<double> ms;
+	for (int i = 0; i < iterations; ++i)
+	{
+		int64_t start = MonotonicNs();
+		fn();
+		ms.push_back(NsToMs(MonotonicNs() - start));
+	}
+	std::sort(ms.begin(), ms.end());
+	return ms[ms.size() / 2];
+}
+
+static void Report(const char* name, size_t threads, double ms, size_t bytes, double baseline_ms)
+{
+	printf("%-22s %3zu threads %9.3f ms %8.1f MB/s %7.2fx\n", name, threads, ms, bytes / (ms * 1e3), baseline_ms / ms);
+}
+
+// a uv sphere, every quad split in two triangles and a relative index here and there
+static std::string Sphere(int segments)
+{
+	std::string obj;
+	obj.reserve((size_t)segments * segments * 160);
+	char line[160];
+	for (int i = 0; i <= segments; ++i)
+	{
+		float theta = 3.14159265f * i / segments;
+		for (int j = 0; j < segments; ++j)
+		{
+			float phi = 6.2831853f * j / segments;
+			float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+			obj.append(line, snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, z, (float)j / segments, (float)i / segments, x, y, z));
+		}
+	}
+	for (int i = 0; i < segments; ++i)
+	{
+		for (int j = 0; j < segments; ++j)
+		{
+			int a = i * segments + j + 1, b = i * segments + (j + 1) % segments + 1, c = a + segments, d = b + segments;
+			obj.append(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+				a, a, a, b, b, b, d, d, d, a, a, a, d, d, d, c, c, c));
+		}
+	}
+	return obj;
+}
+
+static bool SameMesh(const ObjMesh& a, const ObjMesh& b)
+{
+	return a.positions.size() == b.positions.size() && a.uvs.size() == b.uvs.size() && a.normals.size() == b.normals.size() && a.corners.size() == b.corners.size()
+		&& memcmp(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(glm::vec3)) == 0
+		&& memcmp(a.uvs.data(), b.uvs.data(), a.uvs.size() * sizeof(glm::vec2)) == 0
+		&& memcmp(a.normals.data(), b.normals.data(), a.normals.size() * sizeof(glm::vec3)) == 0
+		&& memcmp(a.corners.data(), b.corners.data(), a.corners.size() * sizeof(ObjIndex)) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* source = argc > 1 ? argv[1] : "1000";
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+	int segments = atoi(source);
+	if (iterations < 1)
+	{
+		printf("usage: bench_obj_parse [file.obj | sphere segments] [iterations]\n");
+		return -1;
+	}
+
+	std::string obj;
+	if (segments > 0)
+	{
+		obj = Sphere(segments);
+	}
+	else
+	{
+		std::ifstream file(source, std::ios::binary);
+		if (!file)
+		{
+			printf("can't open %s\n", source);
+			return -1;
+		}
+		obj.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	ObjMesh reference;
+	if (!ReadObj(obj.data(), obj.data() + obj.size(), reference))
+	{
+		printf("%s doesn't parse\n", source);
+		return -1;
+	}
+	printf("%s: %zu mb, %zu triangles, median of %d runs\n\n", segments > 0 ? "generated sphere" : source, obj.size() / (1024 * 1024), reference.Triangles(), iterations);
+
+	// the original parser, on generated meshes only: it can't read quads or partial corners
+	double baseline_ms = 0;
+	if (segments > 0)
+	{
+		baseline_ms = MedianMs(std::min(iterations, 3), [&] { loadobj(obj.c_str()); });
+		Report("loadobj (nscanf)", 1, baseline_ms, obj.size(), baseline_ms);
+	}
+
+	std::vector<size_t> thread_counts;
+	size_t hw = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+	thread_counts.push_back(hw);
+
+	bool mismatch = false;
+	for (size_t threads : thread_counts)
+	{
+		ThreadPool pool(threads);
+		ObjMesh mesh;
+		double ms = MedianMs(iterations, [&] { ReadObj(obj.data(), obj.data() + obj.size(), mesh, &pool); });
+		if (baseline_ms == 0) baseline_ms = ms;
+		Report("ReadObj", threads, ms, obj.size(), baseline_ms);
+
+		if (!SameMesh(mesh, reference))
+		{
+			printf("%-22s output differs from the single threaded parse\n", "");
+			mismatch = true;
+		}
+	}
+	return mismatch ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*
+* texture fill throughput: the original memset32 + makechecker against the single pass
+* FillChecker kernels, per instruction set and thread count.
+*
+*	bench_texture_fill [texture width (4096)] [iterations (20)]
+* */
+#include "stdafx.h"
+#include "logging.h"
+#include "scene.h"
+#include "texture_fill.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+thread_local std::string _instance_name = "bench";
+
+static const uint32_t kColor = 0x3366ccff;
+
+struct AlignedDelete
+{
+	void operator()(uint32_t* p) const { ::operator delete[](p, std::align_val_t(kTextureAlignment)); }
+};
+typedef std::unique_ptr<uint32_t[], AlignedDelete> ImagePtr;
+
+// median of iterations runs after one warm-up run (page faults, pool start-up)
+static double MedianMs(int iterations, const std::function<void()>& fn)
+{
+	fn();
+	std::vector<double> ms;
+	for (int i = 0; i < iterations; ++i)
+	{
+		int64_t start = MonotonicNs();
+		fn();
+		ms.push_back(NsToMs(MonotonicNs() - start));
+	}
+	std::sort(ms.begin(), ms.end());
+	return ms[ms.size() / 2];
+}
+
+static void Report(const char* name, size_t threads, double ms, size_t bytes, double baseline_ms)
+{
+	printf("%-22s %3zu threads %9.3f ms %8.2f GB/s %7.2fx\n", name, threads, ms, bytes / (ms * 1e6), baseline_ms / ms);
+}
+
+int main(int argc, char** argv)
+{
+	size_t wh = argc > 1 ? (size_t)atoi(argv[1]) : 4096;
+	int iterations = argc > 2 ? atoi(argv[2]) : 20;
+	if (wh < 32 || iterations < 1)
+	{
+		printf("usage: bench_texture_fill [texture width] [iterations]\n");
+		return -1;
+	}
+
+	size_t pixels = wh * wh;
+	size_t bytes = pixels * 4;
+	ImagePtr image(new (std::align_val_t(kTextureAlignment)) uint32_t[pixels]);
+	ImagePtr reference(new (std::align_val_t(kTextureAlignment)) uint32_t[pixels]);
+
+	printf("%zux%zu RGBA8 (%zu mb), median of %d runs, best kernel: %s\n\n", wh, wh, bytes / (1024 * 1024), iterations, FillKernelName(BestFillKernel()));
+
+	double baseline_ms = MedianMs(iterations, [&] {
+		memset32(image.get(), kColor, bytes);
+		makechecker(image.get(), wh);
+	});
+	Report("memset32+makechecker", 1, baseline_ms, bytes, baseline_ms);
+
+	FillChecker(reference.get(), wh, kColor, nullptr, FillKernel::Scalar);
+	size_t legacy_diff = 0;
+	for (size_t i = 0; i < pixels; ++i) legacy_diff += image[i] != reference[i];
+	printf("%-22s %zu pixels differ from the original, it misses a cell at the top of every row of cells\n\n", "", legacy_diff);
+
+	std::vector<size_t> thread_counts;
+	size_t hw = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+	thread_counts.push_back(hw);
+
+	bool mismatch = false;
+	for (FillKernel kernel : { FillKernel::Scalar, FillKernel::SSE2, FillKernel::AVX2 })
+	{
+		if (!FillKernelSupported(kernel))
+		{
+			printf("%-22s not supported on this cpu\n", FillKernelName(kernel));
+			continue;
+		}
+
+		for (size_t threads : thread_counts)
+		{
+			ThreadPool pool(threads);
+			double ms = MedianMs(iterations, [&] { FillChecker(image.get(), wh, kColor, &pool, kernel); });
+			Report(FillKernelName(kernel), threads, ms, bytes, baseline_ms);
+
+			if (memcmp(image.get(), reference.get(), bytes) != 0)
+			{
+				printf("%-22s output differs from the scalar kernel\n", FillKernelName(kernel));
+				mismatch = true;
+			}
+		}
+	}
+	return mismatch ? 1 : 0;
+}
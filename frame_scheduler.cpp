@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "frame_scheduler.h"
+#include "timing.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+FrameScheduler::FrameScheduler(int fps)
+	: _fps(std::max(fps, 0))
+	, _interval_ns(fps > 0 ? 1000000000ll / fps : 0)
+{
+#ifdef _WIN32
+	if (_interval_ns > 0)
+	{
+		// high resolution timers need windows 10 1803, older ones get the default timer resolution
+		_timer = ::CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (_timer == NULL) _timer = ::CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+	}
+#endif
+}
+
+FrameScheduler::~FrameScheduler()
+{
+#ifdef _WIN32
+	if (_timer != NULL) ::CloseHandle(_timer);
+#endif
+}
+
+bool FrameScheduler::Wait()
+{
+	int64_t now = MonotonicNs();
+	if (_interval_ns == 0 || _deadline_ns == 0)
+	{
+		_deadline_ns = now + _interval_ns;
+		_stats.frames++;
+		return true;
+	}
+
+	if (now >= _deadline_ns)
+	{
+		_stats.missed++;
+		_stats.worst_late_ns = std::max(_stats.worst_late_ns, now - _deadline_ns);
+		_deadline_ns = now + _interval_ns;
+		_stats.frames++;
+		return true;
+	}
+
+#ifdef _WIN32
+	// waitable timers take absolute times on the system clock only, so the absolute
+	// deadline becomes a relative due time (negative, in 100 ns units) right here
+	LARGE_INTEGER due;
+	due.QuadPart = -std::max<int64_t>((_deadline_ns - now) / 100, 1);
+	bool reached = false;
+	if (_timer != NULL && ::SetWaitableTimer(_timer, &due, 0, NULL, NULL, FALSE))
+	{
+		reached = ::MsgWaitForMultipleObjectsEx(1, &_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE) == WAIT_OBJECT_0;
+	}
+	else
+	{
+		::Sleep((DWORD)((_deadline_ns - now) / 1000000));
+		reached = true;
+	}
+#else
+	// steady_clock is CLOCK_MONOTONIC (see timing.h), so the deadline goes in as is
+	struct timespec ts;
+	ts.tv_sec = (time_t)(_deadline_ns / 1000000000ll);
+	ts.tv_nsec = (long)(_deadline_ns % 1000000000ll);
+	bool reached = ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) != EINTR;
+#endif
+
+	int64_t woke = MonotonicNs();
+	_stats.wait_ns += woke - now;
+	if (!reached) return false;
+
+	_stats.oversleep_ns += std::max<int64_t>(woke - _deadline_ns, 0);
+	_deadline_ns += _interval_ns;
+	_stats.frames++;
+	return true;
+}
+
+FrameSchedulerStats FrameScheduler::TakeStats()
+{
+	FrameSchedulerStats stats = _stats;
+	_stats = FrameSchedulerStats();
+	return stats;
+}
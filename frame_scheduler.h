@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------
+// frame scheduler: paces a render loop to a target rate. every frame has an absolute
+// deadline one interval after the previous one, and the wait goes to that deadline
+// (clock_nanosleep with TIMER_ABSTIME on CLOCK_MONOTONIC, a high resolution waitable
+// timer on win32), so the time a frame took doesn't add up into drift the way a fixed
+// sleep does. a frame that overruns its deadline counts as missed and the schedule
+// restarts from there instead of rushing out the frames that were lost.
+
+struct FrameSchedulerStats
+{
+	size_t		frames = 0;
+	size_t		missed = 0;			// deadlines that had already passed when the frame was done
+	int64_t		worst_late_ns = 0;	// the largest of those overruns
+	int64_t		wait_ns = 0;		// spent waiting for deadlines
+	int64_t		oversleep_ns = 0;	// woken up after the deadline, summed over the waits
+};
+
+class FrameScheduler
+{
+public:
+	// fps 0 doesn't wait at all
+	explicit FrameScheduler(int fps);
+	~FrameScheduler();
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	// wait for the next frame's deadline, the first call returns right away.
+	// returns false when woken early (a signal, or window messages on win32): the
+	// deadline stays and the caller should call again after dealing with them
+	bool	Wait();
+
+	int		Fps() const { return _fps; }
+	// what happened since the last call
+	FrameSchedulerStats	TakeStats();
+
+private:
+	int					_fps;
+	int64_t				_interval_ns;
+	int64_t				_deadline_ns = 0;
+	FrameSchedulerStats	_stats;
+#ifdef _WIN32
+	HANDLE				_timer = NULL;
+#endif
+};
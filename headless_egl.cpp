@@ -0,0 +1,249 @@
+#include "stdafx.h"
+#include "glad.h"
+#include "logging.h"
+#include "headless_egl.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// ------------------------------
+// headless context state, per thread: render threads (--threads) each own a context
+// on the one display of the process, the display is terminated with the last of them
+
+static std::mutex	_displayMutex;
+static EGLDisplay	_sharedDisplay = EGL_NO_DISPLAY;
+static int			_displayUsers = 0;
+
+static thread_local EGLDisplay	_eglDisplay = EGL_NO_DISPLAY;
+static thread_local EGLContext	_eglContext = EGL_NO_CONTEXT;
+static thread_local EGLSurface	_eglSurface = EGL_NO_SURFACE;
+static thread_local GLuint		_fbo = 0;
+static thread_local GLuint		_fboColor = 0;
+static thread_local GLuint		_fboDepth = 0;
+static thread_local GLsync		_frameFence = 0;
+
+static std::string Hex(unsigned int value)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "0x%x", value);
+	return buf;
+}
+
+static bool HasExtension(const char* extensions, const char* name)
+{
+	if (extensions == nullptr) return false;
+	size_t len = strlen(name);
+	for (const char* p = strstr(extensions, name); p != nullptr; p = strstr(p + len, name))
+	{
+		if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0))
+			return true;
+	}
+	return false;
+}
+
+void PreloadHeadless()
+{
+	// querying the client extensions makes glvnd load its vendor libraries, no threads or fds yet
+	eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+}
+
+static EGLDisplay OpenDisplay()
+{
+	const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	// mesa: no window system at all, this is what llvmpipe in a container gets
+	if (getPlatformDisplay != nullptr && HasExtension(client, "EGL_MESA_platform_surfaceless"))
+	{
+		EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display != EGL_NO_DISPLAY)
+		{
+			LOG(INFO) << "[" << _instance_name << "] " << "egl: using the surfaceless platform";
+			return display;
+		}
+	}
+
+	// vendor drivers: pick the first device directly
+	PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+	if (getPlatformDisplay != nullptr && queryDevices != nullptr && HasExtension(client, "EGL_EXT_platform_device"))
+	{
+		EGLDeviceEXT device;
+		EGLint count = 0;
+		if (queryDevices(1, &device, &count) && count > 0)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+			if (display != EGL_NO_DISPLAY)
+			{
+				LOG(INFO) << "[" << _instance_name << "] " << "egl: using the device platform";
+				return display;
+			}
+		}
+	}
+
+	LOG(INFO) << "[" << _instance_name << "] " << "egl: using the default display";
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool InitHeadlessContext(int width, int height)
+{
+	EGLint major = 0, minor = 0;
+	{
+		std::lock_guard<std::mutex> lock(_displayMutex);
+		if (_sharedDisplay == EGL_NO_DISPLAY) _sharedDisplay = OpenDisplay();
+		if (_sharedDisplay == EGL_NO_DISPLAY || !eglInitialize(_sharedDisplay, &major, &minor))
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "eglInitialize failed (" << Hex(eglGetError()) << ")";
+			return false;
+		}
+		_eglDisplay = _sharedDisplay;
+		_displayUsers++;
+	}
+	LOG(INFO) << "[" << _instance_name << "] " << "egl version: " << major << "." << minor << " vendor: " << eglQueryString(_eglDisplay, EGL_VENDOR);
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "eglBindAPI(EGL_OPENGL_API) failed";
+		return false;
+	}
+
+	const EGLint configAttribs[] =
+	{
+		EGL_SURFACE_TYPE,		EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,	EGL_OPENGL_BIT,
+		EGL_RED_SIZE,			8,
+		EGL_GREEN_SIZE,			8,
+		EGL_BLUE_SIZE,			8,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(_eglDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "eglChooseConfig found no pbuffer capable opengl config";
+		return false;
+	}
+
+	// the scene uses a few fixed function calls next to its 330 core shaders, so ask for compatibility
+	const EGLint contextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION,			3,
+		EGL_CONTEXT_MINOR_VERSION,			3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,	EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+	_eglContext = eglCreateContext(_eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (_eglContext == EGL_NO_CONTEXT)
+	{
+		LOG(WARNING) << "[" << _instance_name << "] " << "no 3.3 compatibility context (" << Hex(eglGetError()) << "), trying the default";
+		_eglContext = eglCreateContext(_eglDisplay, config, EGL_NO_CONTEXT, nullptr);
+	}
+	if (_eglContext == EGL_NO_CONTEXT)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "eglCreateContext failed (" << Hex(eglGetError()) << ")";
+		return false;
+	}
+
+	// nothing is ever presented, so a surface is only needed when the driver insists on one
+	if (!HasExtension(eglQueryString(_eglDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+	{
+		const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		_eglSurface = eglCreatePbufferSurface(_eglDisplay, config, pbufferAttribs);
+		if (_eglSurface == EGL_NO_SURFACE)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "eglCreatePbufferSurface failed (" << Hex(eglGetError()) << ")";
+			return false;
+		}
+	}
+
+	if (!eglMakeCurrent(_eglDisplay, _eglSurface, _eglSurface, _eglContext))
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "eglMakeCurrent failed (" << Hex(eglGetError()) << ")";
+		return false;
+	}
+
+	// glad fills process wide pointers, the same ones for every context of the display, so
+	// they're loaded once: render threads (--threads) call through them while others start
+	static std::mutex gladMutex;
+	static bool gladLoaded = false;
+	bool loaded;
+	{
+		std::lock_guard<std::mutex> lock(gladMutex);
+		if (!gladLoaded)
+		{
+			int64_t glad_start = MonotonicNs();
+			gladLoaded = gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+			TraceEvent("gladLoadGL", glad_start, MonotonicNs());
+		}
+		loaded = gladLoaded;
+	}
+	if (!loaded || glad_glCreateShader == nullptr)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "opengl proc: glCreateShader is null";
+		return false;
+	}
+	LOG(INFO) << "[" << _instance_name << "] " << "gladLoadGL version:  " << GLVersion.major << "." << GLVersion.minor
+		<< " renderer: " << glGetString(GL_RENDERER);
+
+	glGenRenderbuffers(1, &_fboColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, _fboColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &_fboDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, _fboDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glGenFramebuffers(1, &_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _fboColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _fboDepth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "offscreen framebuffer incomplete (" << Hex(status) << ")";
+		return false;
+	}
+	glViewport(0, 0, width, height);
+
+	return true;
+}
+
+void PresentHeadless()
+{
+	// a swap would block once the previous frame is still queued, do the same with a fence
+	if (_frameFence != 0)
+	{
+		glClientWaitSync(_frameFence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(_frameFence);
+	}
+	_frameFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+}
+
+void DestroyHeadlessContext()
+{
+	if (_eglDisplay == EGL_NO_DISPLAY) return;
+
+	// like the win32 build, the gl objects themselves are left for the driver to clean up
+	eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (_eglSurface != EGL_NO_SURFACE) eglDestroySurface(_eglDisplay, _eglSurface);
+	if (_eglContext != EGL_NO_CONTEXT) eglDestroyContext(_eglDisplay, _eglContext);
+	{
+		std::lock_guard<std::mutex> lock(_displayMutex);
+		if (--_displayUsers == 0)
+		{
+			eglTerminate(_sharedDisplay);
+			_sharedDisplay = EGL_NO_DISPLAY;
+		}
+	}
+
+	_eglDisplay = EGL_NO_DISPLAY;
+	_eglContext = EGL_NO_CONTEXT;
+	_eglSurface = EGL_NO_SURFACE;
+	_frameFence = 0;
+}
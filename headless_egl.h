@@ -0,0 +1,17 @@
+#pragma once
+
+// ------------------------------
+// headless rendering: an EGL context without any window system (surfaceless
+// where the driver allows it, a pbuffer otherwise) drawing into an offscreen
+// framebuffer object. works on mesa llvmpipe, so no gpu or compositor is needed.
+
+// load the egl vendor libraries without initializing a display, safe to run before a fork
+void	PreloadHeadless();
+
+// create the context, load the gl entrypoints and bind a width x height fbo
+bool	InitHeadlessContext(int width, int height);
+
+// stands in for SwapBuffers, keeps at most one frame in flight
+void	PresentHeadless();
+
+void	DestroyHeadlessContext();
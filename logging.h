@@ -0,0 +1,20 @@
+#pragma once
+
+// every translation unit must see the same easylogging++ configuration,
+// so include this instead of easylogging++.h directly.
+
+#define ELPP_STL_LOGGING
+#define ELPP_FEATURE_ALL
+#define ELPP_THREAD_SAFE
+#ifdef _WIN32
+#define ELPP_DEFAULT_LOG_FILE "logs\\outofproc.log"
+#else
+#define ELPP_DEFAULT_LOG_FILE "logs/outofproc.log"
+#endif
+
+#include "easylogging++.h"
+
+#include <string>
+
+// per thread: render threads (--threads) log under their slot like child processes do
+extern thread_local std::string	_instance_name;
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "glad.h"
+#include "memory_probe.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------
+// sources
+
+#ifndef _WIN32
+
+// a decimal number at the start of a small sysfs or procfs file
+static int64_t ReadCounter(const char* path)
+{
+	int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+	char text[64];
+	ssize_t n = ::read(fd, text, sizeof(text) - 1);
+	::close(fd);
+	if (n <= 0) return -1;
+	text[n] = 0;
+	return strtoll(text, nullptr, 10);
+}
+
+// amdgpu exposes mem_info_vram_used and mem_info_gtt_used per card, connectors (card0-DP-1) don't
+static std::vector<std::string> FindDrmCounters()
+{
+	std::vector<std::string> counters;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/class/drm", ec))
+	{
+		std::string name = entry.path().filename().string();
+		if (name.compare(0, 4, "card") != 0 || name.find('-') != std::string::npos) continue;
+		for (const char* counter : { "mem_info_vram_used", "mem_info_gtt_used" })
+		{
+			std::filesystem::path path = entry.path() / "device" / counter;
+			if (ReadCounter(path.c_str()) >= 0) counters.push_back(path.string());
+		}
+	}
+	return counters;
+}
+
+// MemTotal - MemAvailable, in bytes
+static int64_t SystemMemoryUsed()
+{
+	FILE* file = fopen("/proc/meminfo", "r");
+	if (file == nullptr) return -1;
+	char line[128];
+	long long total = -1, available = -1;
+	while (fgets(line, sizeof(line), file) && (total < 0 || available < 0))
+	{
+		if (strncmp(line, "MemTotal:", 9) == 0) total = strtoll(line + 9, nullptr, 10);
+		else if (strncmp(line, "MemAvailable:", 13) == 0) available = strtoll(line + 13, nullptr, 10);
+	}
+	fclose(file);
+	return total < 0 || available < 0 ? -1 : (total - available) * 1024;
+}
+
+#else
+
+static int64_t SystemMemoryUsed()
+{
+	MEMORYSTATUSEX status = { sizeof(status) };
+	if (!::GlobalMemoryStatusEx(&status)) return -1;
+	return (int64_t)(status.ullTotalPhys - status.ullAvailPhys);
+}
+
+#endif
+
+// ------------------------------
+// probe
+
+bool MemoryProbe::Init()
+{
+	// the extension flags are only set once gladLoadGL ran against a current context
+	if (GLAD_GL_NVX_gpu_memory_info) _source = MemorySource::Nvx;
+	else if (GLAD_GL_ATI_meminfo) _source = MemorySource::Ati;
+#ifndef _WIN32
+	else if (!(_drm_counters = FindDrmCounters()).empty()) _source = MemorySource::Drm;
+#endif
+	else if (SystemMemoryUsed() >= 0) _source = MemorySource::System;
+	else _source = MemorySource::None;
+	return _source != MemorySource::None;
+}
+
+const char* MemoryProbe::SourceName() const
+{
+	switch (_source)
+	{
+	case MemorySource::Nvx:		return "NVX_gpu_memory_info";
+	case MemorySource::Ati:		return "ATI_meminfo";
+	case MemorySource::Drm:		return "drm sysfs";
+	case MemorySource::System:	return "system memory";
+	default:					return "none";
+	}
+}
+
+int64_t MemoryProbe::Sample() const
+{
+	switch (_source)
+	{
+	case MemorySource::Nvx:
+	{
+		GLint total_kb = 0, available_kb = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total_kb);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available_kb);
+		return ((int64_t)total_kb - available_kb) * 1024;
+	}
+	case MemorySource::Ati:
+	{
+		GLint free_kb[4] = {};
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free_kb);
+		return -(int64_t)free_kb[0] * 1024;
+	}
+#ifndef _WIN32
+	case MemorySource::Drm:
+	{
+		int64_t used = 0;
+		for (const std::string& counter : _drm_counters) used += std::max<int64_t>(ReadCounter(counter.c_str()), 0);
+		return used;
+	}
+#endif
+	case MemorySource::System:
+		return std::max<int64_t>(SystemMemoryUsed(), 0);
+	default:
+		return 0;
+	}
+}
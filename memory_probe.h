@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// ------------------------------
+// memory probe: how much memory the driver has handed out, from the best source there
+// is. GL_NVX_gpu_memory_info and GL_ATI_meminfo need a current context; on linux the
+// drm sysfs counters of amdgpu (vram + gtt) come next, and as a last resort the system
+// memory in use (/proc/meminfo, GlobalMemoryStatusEx on win32), which is where software
+// rasterizers and unified memory gpus allocate from. only differences between samples
+// mean anything: ATI reports free memory only, which is turned into a negative "used".
+
+enum class MemorySource
+{
+	None,
+	Nvx,
+	Ati,
+	Drm,
+	System,
+};
+
+class MemoryProbe
+{
+public:
+	// pick the source, the gl ones only when a context is current
+	bool			Init();
+
+	MemorySource	Source() const { return _source; }
+	const char*		SourceName() const;
+
+	// bytes in use, 0 without a source
+	int64_t			Sample() const;
+
+private:
+	MemorySource				_source = MemorySource::None;
+	std::vector<std::string>	_drm_counters;
+};
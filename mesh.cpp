@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "mesh.h"
+#include "obj_reader.h"
+
+// ------------------------------
+// corner deduplication: open addressing over the corner triples, the table
+// holds vertex numbers and the triples live in keys
+
+static uint32_t HashCorner(const ObjIndex& c)
+{
+	uint32_t h = (uint32_t)c.v * 0x9e3779b1u;
+	h ^= (uint32_t)c.vt * 0x85ebca77u + (h << 6) + (h >> 2);
+	h ^= (uint32_t)c.vn * 0xc2b2ae3du + (h << 6) + (h >> 2);
+	return h ^ (h >> 15);
+}
+
+static bool SameCorner(const ObjIndex& a, const ObjIndex& b)
+{
+	return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+}
+
+void BuildIndexedMesh(const ObjMesh& obj, IndexedMesh& mesh)
+{
+	const uint32_t kEmpty = 0xffffffffu;
+	size_t capacity = 16;
+	while (capacity < obj.corners.size() * 2) capacity *= 2;
+	std::vector< uint32_t > table(capacity, kEmpty);
+	std::vector< ObjIndex > keys;
+	keys.reserve(obj.corners.size());
+
+	mesh.indices.resize(obj.corners.size());
+	for (size_t i = 0; i < obj.corners.size(); ++i)
+	{
+		const ObjIndex& corner = obj.corners[i];
+		size_t slot = HashCorner(corner) & (capacity - 1);
+		while (table[slot] != kEmpty && !SameCorner(keys[table[slot]], corner))
+			slot = (slot + 1) & (capacity - 1);
+		if (table[slot] == kEmpty)
+		{
+			table[slot] = (uint32_t)keys.size();
+			keys.push_back(corner);
+		}
+		mesh.indices[i] = table[slot];
+	}
+
+	mesh.vertices.resize(keys.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		const ObjIndex& key = keys[i];
+		MeshVertex& vertex = mesh.vertices[i];
+		vertex.position = obj.positions[key.v];
+		vertex.uv = key.vt < 0 ? glm::vec2(0) : obj.uvs[key.vt];
+		vertex.normal = key.vn < 0 ? glm::vec3(0) : obj.normals[key.vn];
+	}
+}
+
+// ------------------------------
+// tipsify: fan around the last emitted vertex that is still in the cache and
+// has live triangles left, fall back to recently emitted vertices (dead ends),
+// and only then to the next vertex in input order. linear in the mesh size
+
+void OptimizeVertexCache(IndexedMesh& mesh, int cache_size)
+{
+	const size_t vertex_count = mesh.vertices.size();
+	const size_t triangle_count = mesh.Triangles();
+	if (triangle_count == 0) return;
+	const std::vector< uint32_t >& in = mesh.indices;
+
+	// vertex -> triangles adjacency, as offsets into one array
+	std::vector< uint32_t > live(vertex_count, 0);
+	for (uint32_t v : in) live[v]++;
+	std::vector< uint32_t > offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v) offsets[v + 1] = offsets[v] + live[v];
+	std::vector< uint32_t > adjacency(in.size());
+	{
+		std::vector< uint32_t > fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < in.size(); ++i) adjacency[fill[in[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector< uint32_t > out;
+	out.reserve(in.size());
+	std::vector< uint32_t > stamp(vertex_count, 0);
+	std::vector< char > emitted(triangle_count, 0);
+	std::vector< uint32_t > dead_ends;
+	std::vector< uint32_t > candidates;
+	dead_ends.reserve(in.size());
+
+	const uint32_t k = (uint32_t)cache_size;
+	uint32_t time = k + 1;	// every vertex starts out of the cache
+	size_t cursor = 0;
+	int64_t fan = 0;
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a)
+		{
+			uint32_t t = adjacency[a];
+			if (emitted[t]) continue;
+			for (int c = 0; c < 3; ++c)
+			{
+				uint32_t v = in[t * 3 + c];
+				out.push_back(v);
+				dead_ends.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamp[v] > k)
+				{
+					stamp[v] = time++;
+				}
+			}
+			emitted[t] = 1;
+		}
+
+		// the candidate that stays in the cache while its remaining triangles go out
+		fan = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates)
+		{
+			if (live[v] == 0) continue;
+			int64_t priority = 0;
+			if (time - stamp[v] + 2 * live[v] <= k) priority = time - stamp[v];
+			if (priority > best)
+			{
+				best = priority;
+				fan = v;
+			}
+		}
+		if (fan >= 0) continue;
+
+		while (!dead_ends.empty() && fan < 0)
+		{
+			uint32_t v = dead_ends.back();
+			dead_ends.pop_back();
+			if (live[v] > 0) fan = v;
+		}
+		for (; fan < 0 && cursor < vertex_count; ++cursor)
+		{
+			if (live[cursor] > 0) fan = (int64_t)cursor;
+		}
+	}
+
+	// vertices in first use order
+	const uint32_t kUnused = 0xffffffffu;
+	std::vector< uint32_t > remap(vertex_count, kUnused);
+	std::vector< MeshVertex > vertices;
+	vertices.reserve(vertex_count);
+	for (uint32_t& v : out)
+	{
+		if (remap[v] == kUnused)
+		{
+			remap[v] = (uint32_t)vertices.size();
+			vertices.push_back(mesh.vertices[v]);
+		}
+		v = remap[v];
+	}
+	mesh.vertices.swap(vertices);
+	mesh.indices.swap(out);
+}
+
+float VertexCacheMissRatio(const IndexedMesh& mesh, int cache_size)
+{
+	if (mesh.Triangles() == 0) return 0;
+
+	// fifo: a vertex is cached while fewer than cache_size misses came after its own
+	std::vector< uint32_t > stamp(mesh.vertices.size(), 0);
+	uint32_t misses = 0;
+	for (uint32_t v : mesh.indices)
+	{
+		if (stamp[v] == 0 || misses - stamp[v] >= (uint32_t)cache_size)
+		{
+			stamp[v] = ++misses;
+		}
+	}
+	return (float)misses / (float)mesh.Triangles();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "glm/glm.hpp"
+
+struct ObjMesh;
+
+// ------------------------------
+// indexed mesh: one interleaved vertex per distinct (v, vt, vn) corner and
+// 32 bit indices, ready for a single vbo + ebo and glDrawElements
+
+struct MeshVertex
+{
+	glm::vec3	position;
+	glm::vec2	uv;
+	glm::vec3	normal;
+};
+
+// what the gl buffers are filled from, owned by an IndexedMesh or a mapped cache file
+struct MeshView
+{
+	const MeshVertex*	vertices = nullptr;
+	size_t				vertex_count = 0;
+	const uint32_t*		indices = nullptr;
+	size_t				index_count = 0;
+};
+
+struct IndexedMesh
+{
+	std::vector< MeshVertex >	vertices;
+	std::vector< uint32_t >		indices;	// 3 per triangle
+
+	size_t		Triangles() const { return indices.size() / 3; }
+	MeshView	View() const { return { vertices.data(), vertices.size(), indices.data(), indices.size() }; }
+};
+
+// post-transform cache most drivers are tuned for, in vertices
+const int kVertexCacheSize = 16;
+
+// merge the corners of an obj mesh that share all three attribute indices,
+// corners without a uv or normal get zeros
+void	BuildIndexedMesh(const ObjMesh& obj, IndexedMesh& mesh);
+
+// reorder the triangles for the post-transform vertex cache (tipsify, sander et al. 2007),
+// then renumber the vertices in first use order so fetching them walks memory forward
+void	OptimizeVertexCache(IndexedMesh& mesh, int cache_size = kVertexCacheSize);
+
+// average cache miss ratio: transformed vertices per triangle with a fifo cache,
+// 0.5 is the best a regular grid gets, 3 means no reuse at all
+float	VertexCacheMissRatio(const IndexedMesh& mesh, int cache_size = kVertexCacheSize);
@@ -0,0 +1,248 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "mesh_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define MESH_CACHE_DIR "logs\\meshes"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MESH_CACHE_DIR "logs/meshes"
+#endif
+
+static const uint32_t kMeshCacheMagic = 0x534d4f4f;	// "OOMS"
+static const uint32_t kMeshCacheVersion = 1;
+static const size_t kBlockAlignment = 4096;
+
+struct MeshCacheHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vertex_stride;	// sizeof(MeshVertex) when written
+	uint32_t	reserved;
+	uint64_t	vertex_count;
+	uint64_t	index_count;
+	uint64_t	vertex_offset;	// both blocks are kBlockAlignment aligned
+	uint64_t	index_offset;
+	uint64_t	source_size;
+	int64_t		source_time;	// last write time of the source, in file clock ticks
+};
+
+static size_t AlignUp(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+// ------------------------------
+// source identity
+
+struct SourceInfo
+{
+	std::filesystem::path	entry;
+	uint64_t				size;
+	int64_t					time;
+};
+
+static bool GetSourceInfo(const char* source, SourceInfo& info)
+{
+	std::error_code ec;
+	std::filesystem::path path = std::filesystem::absolute(source, ec);
+	if (ec) return false;
+	info.size = std::filesystem::file_size(path, ec);
+	if (ec) return false;
+	info.time = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	if (ec) return false;
+
+	// fnv-1a of the absolute path
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (char c : path.string())
+	{
+		h ^= (unsigned char)c;
+		h *= 0x100000001b3ull;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)h);
+	info.entry = std::filesystem::path(MESH_CACHE_DIR) / name;
+	return true;
+}
+
+// ------------------------------
+// platform
+
+#ifdef _WIN32
+
+static void* MapFile(const std::filesystem::path& path, size_t& size)
+{
+	HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+	LARGE_INTEGER length;
+	HANDLE mapping = NULL;
+	if (::GetFileSizeEx(file, &length) && length.QuadPart > 0)
+	{
+		mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	::CloseHandle(file);
+	if (mapping == NULL) return nullptr;
+
+	void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	::CloseHandle(mapping);	// the view keeps the section alive
+	size = (size_t)length.QuadPart;
+	return view;
+}
+
+static void UnmapFile(void* view, size_t size)
+{
+	UNREFERENCED_PARAMETER(size);
+	::UnmapViewOfFile(view);
+}
+
+#else
+
+static void* MapFile(const std::filesystem::path& path, size_t& size)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return nullptr;
+
+	struct stat st;
+	void* view = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		size = (size_t)st.st_size;
+		view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+	return view == MAP_FAILED ? nullptr : view;
+}
+
+static void UnmapFile(void* view, size_t size)
+{
+	::munmap(view, size);
+}
+
+#endif
+
+// ------------------------------
+// reading
+
+bool MappedMesh::Open(const char* source)
+{
+	Close();
+	if (!kMesh_cache) return false;
+
+	SourceInfo info;
+	if (!GetSourceInfo(source, info)) return false;
+
+	size_t size = 0;
+	void* view = MapFile(info.entry, size);
+	if (view == nullptr) return false;
+
+	const MeshCacheHeader* header = (const MeshCacheHeader*)view;
+	bool valid = size >= sizeof(MeshCacheHeader)
+		&& header->magic == kMeshCacheMagic && header->version == kMeshCacheVersion
+		&& header->vertex_stride == sizeof(MeshVertex)
+		&& header->source_size == info.size && header->source_time == info.time
+		&& header->vertex_offset % kBlockAlignment == 0 && header->index_offset % kBlockAlignment == 0
+		&& header->vertex_offset + header->vertex_count * sizeof(MeshVertex) <= size
+		&& header->index_offset + header->index_count * sizeof(uint32_t) <= size;
+	if (!valid)
+	{
+		// written by another build, or the source changed since: parse it again
+		UnmapFile(view, size);
+		return false;
+	}
+
+	_view = view;
+	_size = size;
+	return true;
+}
+
+void MappedMesh::Close()
+{
+	if (_view == nullptr) return;
+	UnmapFile(_view, _size);
+	_view = nullptr;
+	_size = 0;
+}
+
+MeshView MappedMesh::View() const
+{
+	if (_view == nullptr) return MeshView();
+	const MeshCacheHeader* header = (const MeshCacheHeader*)_view;
+	MeshView view;
+	view.vertices = (const MeshVertex*)((const char*)_view + header->vertex_offset);
+	view.vertex_count = (size_t)header->vertex_count;
+	view.indices = (const uint32_t*)((const char*)_view + header->index_offset);
+	view.index_count = (size_t)header->index_count;
+	return view;
+}
+
+// ------------------------------
+// writing
+
+static void WritePadding(std::ofstream& file, size_t to)
+{
+	static const char zeros[kBlockAlignment] = {};
+	size_t at = (size_t)file.tellp();
+	if (to > at) file.write(zeros, to - at);
+}
+
+void StoreMeshCache(const char* source, const IndexedMesh& mesh)
+{
+	if (!kMesh_cache) return;
+
+	SourceInfo info;
+	if (!GetSourceInfo(source, info)) return;
+
+	MeshCacheHeader header = {};
+	header.magic = kMeshCacheMagic;
+	header.version = kMeshCacheVersion;
+	header.vertex_stride = sizeof(MeshVertex);
+	header.vertex_count = mesh.vertices.size();
+	header.index_count = mesh.indices.size();
+	header.vertex_offset = AlignUp(sizeof(MeshCacheHeader), kBlockAlignment);
+	header.index_offset = AlignUp(header.vertex_offset + mesh.vertices.size() * sizeof(MeshVertex), kBlockAlignment);
+	header.source_size = info.size;
+	header.source_time = info.time;
+
+	// children respawn in parallel: write a private file and rename it over the entry
+	std::error_code ec;
+	std::filesystem::create_directories(MESH_CACHE_DIR, ec);
+	std::filesystem::path temp = info.entry;
+#ifdef _WIN32
+	temp += "." + std::to_string(::GetCurrentProcessId());
+#else
+	temp += "." + std::to_string(::getpid());
+#endif
+	temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));	// render threads, --threads
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		WritePadding(file, header.vertex_offset);
+		file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex));
+		WritePadding(file, header.index_offset);
+		file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		if (!file)
+		{
+			LOG(WARNING) << "[" << _instance_name << "] " << "mesh cache: can't write " << temp.string();
+			file.close();
+			std::filesystem::remove(temp, ec);
+			return;
+		}
+	}
+	std::filesystem::rename(temp, info.entry, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp, ec);
+	}
+}
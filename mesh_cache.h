@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mesh.h"
+
+// ------------------------------
+// mesh cache: the indexed, cache optimized mesh of an obj file is written once
+// to logs/meshes/ (a header and page aligned vertex and index blocks), later
+// loads map that file and hand the mapped blocks straight to the gl buffers.
+// entries are keyed by the source path and dropped when its size or modification
+// time changes.
+
+class MappedMesh
+{
+public:
+	MappedMesh() {}
+	~MappedMesh() { Close(); }
+	MappedMesh(const MappedMesh&) = delete;
+	MappedMesh& operator=(const MappedMesh&) = delete;
+
+	// map the cache entry of source, false on a miss or a stale entry
+	bool		Open(const char* source);
+	void		Close();
+
+	bool		Valid() const { return _view != nullptr; }
+	MeshView	View() const;
+
+private:
+	void*		_view = nullptr;
+	size_t		_size = 0;
+};
+
+// write the cache entry of source
+void	StoreMeshCache(const char* source, const IndexedMesh& mesh);
@@ -0,0 +1,292 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "obj_reader.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+
+// ------------------------------
+// scanning helpers, all of them stop at end and never at a null
+
+static bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipBlanks(const char* p, const char* end)
+{
+	while (p < end && IsBlank(*p)) ++p;
+	return p;
+}
+
+static const char* NextLine(const char* p, const char* end)
+{
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+// from_chars rejects a leading '+', which some exporters write
+static const char* ParseFloat(const char* p, const char* end, float& value)
+{
+	p = SkipBlanks(p, end);
+	if (p < end && *p == '+') ++p;
+	std::from_chars_result res = std::from_chars(p, end, value);
+	return res.ec == std::errc() ? res.ptr : nullptr;
+}
+
+static const char* ParseInt(const char* p, const char* end, int32_t& value)
+{
+	if (p < end && *p == '+') ++p;
+	std::from_chars_result res = std::from_chars(p, end, value);
+	return res.ec == std::errc() ? res.ptr : nullptr;
+}
+
+// 1 based, or negative relative to the count read so far
+static bool ResolveIndex(int32_t& index, size_t count)
+{
+	if (index > 0) index -= 1;
+	else if (index < 0) index += (int32_t)count;
+	else return false;
+	return index >= 0 && (size_t)index < count;
+}
+
+// ------------------------------
+// chunks: the buffer is cut at line boundaries, every chunk is counted first,
+// so prefix sums over the counts tell each one where its attributes go and how
+// many came before it, which is all relative indices need. chunks then parse in
+// parallel straight into the shared attribute arrays, only their triangles are
+// collected separately and appended in order
+
+struct ObjChunk
+{
+	ObjChunk(const char* b, const char* e) : begin(b), end(e) {}
+
+	const char*	begin;
+	const char*	end;
+
+	// CountChunk
+	size_t		lines = 0;
+	size_t		v = 0, vt = 0, vn = 0, f = 0;
+
+	// ParseChunk
+	std::vector< ObjIndex >	corners;
+	const char*	error = nullptr;
+	size_t		error_line = 0;		// within the chunk
+};
+
+// below this a chunk isn't worth a thread
+static const size_t kMinChunkBytes = 1 << 20;
+
+static void CountChunk(ObjChunk& chunk)
+{
+	for (const char* p = chunk.begin; p < chunk.end; p = NextLine(p, chunk.end))
+	{
+		chunk.lines++;
+		p = SkipBlanks(p, chunk.end);
+		if (chunk.end - p < 2) continue;
+		if (p[0] == 'v')
+		{
+			if (IsBlank(p[1])) chunk.v++;
+			else if (p[1] == 't') chunk.vt++;
+			else if (p[1] == 'n') chunk.vn++;
+		}
+		else if (p[0] == 'f' && IsBlank(p[1])) chunk.f++;
+	}
+}
+
+// v, vt and vn are the numbers of each read before this chunk, the arrays of mesh are already sized
+static void ParseChunk(ObjChunk& chunk, ObjMesh& mesh, size_t v, size_t vt, size_t vn)
+{
+	const char* end = chunk.end;
+	chunk.corners.reserve(chunk.f * 3);	// quads and larger polygons still grow it
+
+	size_t line = 0;
+	const char* error = nullptr;
+	for (const char* p = chunk.begin; p < end && error == nullptr; p = NextLine(p, end))
+	{
+		line++;
+		p = SkipBlanks(p, end);
+		if (end - p < 2) continue;
+
+		if (p[0] == 'v' && IsBlank(p[1]))
+		{
+			glm::vec3& pos = mesh.positions[v];
+			const char* q = p + 1;
+			if ((q = ParseFloat(q, end, pos.x)) && (q = ParseFloat(q, end, pos.y)) && (q = ParseFloat(q, end, pos.z)))
+				v++;
+			else
+				error = "bad position";
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			// a third (w) coordinate is allowed and ignored
+			glm::vec2& uv = mesh.uvs[vt];
+			const char* q = p + 2;
+			if ((q = ParseFloat(q, end, uv.x)) && (q = ParseFloat(q, end, uv.y)))
+				vt++;
+			else
+				error = "bad texture coordinate";
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
+		{
+			glm::vec3& n = mesh.normals[vn];
+			const char* q = p + 2;
+			if ((q = ParseFloat(q, end, n.x)) && (q = ParseFloat(q, end, n.y)) && (q = ParseFloat(q, end, n.z)))
+				vn++;
+			else
+				error = "bad normal";
+		}
+		else if (p[0] == 'f' && IsBlank(p[1]))
+		{
+			ObjIndex first = {}, previous = {};
+			int corners = 0;
+			const char* q = p + 1;
+			for (;;)
+			{
+				q = SkipBlanks(q, end);
+				if (q >= end || *q == '\n' || *q == '#') break;
+
+				ObjIndex corner = { 0, 0, 0 };
+				if (!(q = ParseInt(q, end, corner.v)) || !ResolveIndex(corner.v, v))
+				{
+					error = "bad face position index";
+					break;
+				}
+				corner.vt = corner.vn = -1;
+				if (q < end && *q == '/')
+				{
+					++q;
+					if (q < end && *q != '/')
+					{
+						if (!(q = ParseInt(q, end, corner.vt)) || !ResolveIndex(corner.vt, vt))
+						{
+							error = "bad face texture coordinate index";
+							break;
+						}
+					}
+					if (q < end && *q == '/')
+					{
+						++q;
+						if (!(q = ParseInt(q, end, corner.vn)) || !ResolveIndex(corner.vn, vn))
+						{
+							error = "bad face normal index";
+							break;
+						}
+					}
+				}
+
+				// fan: (first, previous, corner) for every corner past the second
+				if (corners == 0) first = corner;
+				else if (corners >= 2)
+				{
+					chunk.corners.push_back(first);
+					chunk.corners.push_back(previous);
+					chunk.corners.push_back(corner);
+				}
+				previous = corner;
+				corners++;
+			}
+			if (error == nullptr && corners < 3)
+				error = "face with less than 3 corners";
+		}
+		// o, g, s, usemtl, mtllib, l, comments... nothing to draw
+	}
+
+	chunk.error = error;
+	chunk.error_line = line;
+}
+
+// ------------------------------
+// reader
+
+bool ReadObj(const char* begin, const char* end, ObjMesh& mesh, ThreadPool* pool)
+{
+	mesh = ObjMesh();
+
+	// one chunk per thread, each starting right after a newline
+	size_t count = pool ? pool->Size() : 1;
+	count = std::max<size_t>(1, std::min(count, (size_t)(end - begin) / kMinChunkBytes));
+	std::vector< ObjChunk > chunks;
+	chunks.reserve(count);
+	const char* from = begin;
+	for (size_t c = 0; c < count && from < end; ++c)
+	{
+		const char* to = c + 1 == count ? end : NextLine(std::max(from, begin + (end - begin) * (c + 1) / count), end);
+		chunks.emplace_back(from, to);
+		from = to;
+	}
+
+	auto for_chunks = [&](const std::function<void(ObjChunk&, size_t)>& fn)
+	{
+		if (pool && chunks.size() > 1)
+			pool->ParallelFor(chunks.size(), [&](size_t b, size_t e) { for (size_t c = b; c < e; ++c) fn(chunks[c], c); });
+		else
+			for (size_t c = 0; c < chunks.size(); ++c) fn(chunks[c], c);
+	};
+
+	for_chunks([](ObjChunk& chunk, size_t) { CountChunk(chunk); });
+
+	// prefix sums: attributes read before each chunk
+	std::vector< size_t > v(chunks.size() + 1), vt(chunks.size() + 1), vn(chunks.size() + 1);
+	for (size_t c = 0; c < chunks.size(); ++c)
+	{
+		v[c + 1] = v[c] + chunks[c].v;
+		vt[c + 1] = vt[c] + chunks[c].vt;
+		vn[c + 1] = vn[c] + chunks[c].vn;
+	}
+	mesh.positions.resize(v.back());
+	mesh.uvs.resize(vt.back());
+	mesh.normals.resize(vn.back());
+
+	for_chunks([&](ObjChunk& chunk, size_t c) { ParseChunk(chunk, mesh, v[c], vt[c], vn[c]); });
+
+	// the first error in file order, its line counted from the start of the file
+	size_t line = 0;
+	size_t corners = 0;
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (chunk.error)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "obj: " << chunk.error << " on line " << line + chunk.error_line;
+			mesh = ObjMesh();
+			return false;
+		}
+		line += chunk.lines;
+		corners += chunk.corners.size();
+	}
+
+	if (chunks.size() == 1)
+	{
+		mesh.corners.swap(chunks[0].corners);
+	}
+	else
+	{
+		mesh.corners.reserve(corners);
+		for (const ObjChunk& chunk : chunks) mesh.corners.insert(mesh.corners.end(), chunk.corners.begin(), chunk.corners.end());
+	}
+	return true;
+}
+
+bool ReadObjFile(const char* path, ObjMesh& mesh, ThreadPool* pool)
+{
+	// ftell is 32 bit on windows, production meshes aren't
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(path, ec);
+	FILE* file = ec ? nullptr : fopen(path, "rb");
+	if (file == nullptr)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "obj: can't open " << path;
+		return false;
+	}
+
+	std::vector<char> buffer((size_t)size);
+	buffer.resize(fread(buffer.data(), 1, buffer.size(), file));
+	fclose(file);
+
+	return ReadObj(buffer.data(), buffer.data() + buffer.size(), mesh, pool);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "glm/glm.hpp"
+
+class ThreadPool;
+
+// ------------------------------
+// obj reader: wavefront obj (v, vt, vn and f) parsed with std::from_chars straight
+// into arrays sized by a quick counting sweep. unlike loadobj it keeps the
+// mesh indexed, handles v, v/vt, v//vn and v/vt/vn corners, negative (relative)
+// indices and polygons (fanned into triangles). everything else is skipped.
+// with a pool, large buffers are split at line boundaries and parsed in parallel.
+
+// one corner of a triangle, 0 based indices into the attribute arrays, -1 if absent
+struct ObjIndex
+{
+	int32_t		v;
+	int32_t		vt;
+	int32_t		vn;
+};
+
+struct ObjMesh
+{
+	std::vector< glm::vec3 >	positions;
+	std::vector< glm::vec2 >	uvs;
+	std::vector< glm::vec3 >	normals;
+	std::vector< ObjIndex >		corners;	// 3 per triangle
+
+	size_t	Triangles() const { return corners.size() / 3; }
+};
+
+// parse [begin, end), the buffer doesn't need to be null terminated.
+// returns false (and logs the line) on a malformed or out of range face
+bool	ReadObj(const char* begin, const char* end, ObjMesh& mesh, ThreadPool* pool = nullptr);
+
+// read and parse a whole file
+bool	ReadObjFile(const char* path, ObjMesh& mesh, ThreadPool* pool = nullptr);
@@ -525,7 +525,11 @@ namespace option
 	inline char* ReadFile(const char* filename)
 	{
 		FILE* f = nullptr;
+#ifdef _WIN32
 		fopen_s(&f, filename, "r");
+#else
+		f = fopen(filename, "r");
+#endif
 		if (f == 0)
 			return nullptr;
 		fseek(f, 0, SEEK_END);
@@ -663,7 +667,11 @@ namespace option
 		if (!argv)
 			return nullptr;
 		cmdline = (char*)(argv + argc + 1);
+#ifdef _WIN32
 		strcpy_s(cmdline, len, lpCmdline);
+#else
+		memcpy(cmdline, lpCmdline, len);
+#endif
 
 		/* --- Then split and copy the arguments */
 		argv[0] = d = cmdline;
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "process_supervisor.h"
+#include "reclaim_monitor.h"
+#include "settings.h"
+#include "shared_metrics.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+void ProcessSupervisor::KillSlots(const std::vector<int>& slots, int timeout_ms, bool graceful)
+{
+	if (slots.empty()) return;
+
+	TraceScope trace("kill wave", (int)slots.size());
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (_reclaim) _reclaim->BeginWave(Count(), slots.size());
+	KillWave(slots, timeout_ms, graceful);
+	if (_reclaim) _reclaim->EndWave();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	_stats.waves++;
+	_stats.last_wave_ms = ms;
+	_stats.worst_wave_ms = std::max(_stats.worst_wave_ms, ms);
+	_stats.total_wave_ms += ms;
+	LOG(INFO) << "[" << _instance_name << "] " << "killed " << slots.size() << " children in " << ms << " ms"
+		<< " (spawned: " << _stats.spawned << ", avg spawn: " << (_stats.spawned ? _stats.total_spawn_ms / _stats.spawned : 0) << " ms"
+		<< ", ready: " << _stats.ready << ", avg ready: " << (_stats.ready ? _stats.total_ready_ms / _stats.ready : 0) << " ms"
+		<< ", reaped: " << _stats.reaped << ", avg reap: " << (_stats.reaped ? _stats.total_reap_ms / _stats.reaped : 0) << " ms)";
+}
+
+void ProcessSupervisor::KillWave(const std::vector<int>& slots, int timeout_ms, bool graceful)
+{
+	for (int slot : slots) Kill(slot, timeout_ms, graceful);
+}
+
+long long ProcessSupervisor::FreedAt(int slot) const
+{
+	return slot < (int)_freed_at.size() ? _freed_at[slot] : 0;
+}
+
+void ProcessSupervisor::MarkFreed(int slot)
+{
+	if (slot >= (int)_freed_at.size()) _freed_at.resize(slot + 1, 0);
+	_freed_at[slot] = MonotonicNs();
+	ReleaseMetricsSlot(slot);
+}
+
+void ProcessSupervisor::MarkReady(int slot, long long spawned_at_ns, bool ready)
+{
+	if (!ready)
+	{
+		_stats.ready_failures++;
+		LOG(WARNING) << "[" << _instance_name << "] " << "child " << slot << " exited before its first frame";
+		return;
+	}
+
+	double ms = NsToMs(MonotonicNs() - spawned_at_ns);
+	_stats.ready++;
+	_stats.last_ready_ms = ms;
+	_stats.total_ready_ms += ms;
+	LOG(INFO) << "[" << _instance_name << "] " << "child " << slot << " ready in " << ms << " ms";
+}
+
+void NotifyFirstFrame()
+{
+	if (!SignalThreadReady()) SignalReady();
+	if (kSpawned_at_ns == 0) return;
+
+	int64_t now = MonotonicNs();
+	RecordPhase(MetricsPhase::FirstFrame, now - kSpawned_at_ns);
+	TraceEvent("spawn to first frame", kSpawned_at_ns, now, kInstance_slot);
+	if (kSlot_freed_at_ns != 0)
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "first frame " << NsToMs(now - kSpawned_at_ns) << " ms after spawn, "
+			<< NsToMs(now - kSlot_freed_at_ns) << " ms after the previous child in this slot was killed";
+	}
+	else
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "first frame " << NsToMs(now - kSpawned_at_ns) << " ms after spawn";
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ReclaimMonitor;
+
+// ------------------------------
+// process supervisor, spawns copies of this executable into numbered slots
+// and kills/reaps them again (CreateProcess on win32, posix_spawn elsewhere)
+
+struct SupervisorStats
+{
+	size_t		spawned = 0;
+	size_t		spawn_failures = 0;
+	size_t		reaped = 0;
+	size_t		reap_timeouts = 0;
+	double		last_spawn_ms = 0;		// time spent launching the last child
+	double		last_reap_ms = 0;		// kill -> child fully reaped, for the last child
+	double		total_spawn_ms = 0;
+	double		total_reap_ms = 0;
+	size_t		ready = 0;				// children that reported their first frame
+	size_t		ready_failures = 0;		// children that died before their first frame
+	double		last_ready_ms = 0;		// spawn request -> first frame, for the last child
+	double		total_ready_ms = 0;
+	size_t		waves = 0;				// KillAll calls that had children to kill
+	double		last_wave_ms = 0;		// first kill -> last child reaped (or given up on), for the last wave
+	double		worst_wave_ms = 0;
+	double		total_wave_ms = 0;
+};
+
+class ProcessSupervisor
+{
+public:
+	virtual ~ProcessSupervisor() {}
+
+	// launch a child in the lowest free slot, the child gets "--instance <slot> --session <pid>"
+	// (and the spawn/kill timestamps) appended to the master's own arguments.
+	// returns the slot or -1 on failure.
+	virtual int Spawn() = 0;
+
+	// wait until every child spawned so far has presented its first frame (or died), at most timeout_ms.
+	// returns the number of children that became ready. on win32 it also returns early when
+	// window messages arrive, so the caller can keep pumping them.
+	virtual int WaitReady(int timeout_ms) = 0;
+
+	// children spawned but not ready yet
+	virtual size_t Pending() const = 0;
+
+	// terminate the child in slot and wait up to timeout_ms for it to go away.
+	// graceful asks the child to exit first (SIGTERM) before killing it outright.
+	virtual bool Kill(int slot, int timeout_ms, bool graceful = false) = 0;
+
+	// kill the children in slots as one wave. the whole wave is terminated at once and waited
+	// for together, so it takes about timeout_ms at worst instead of timeout_ms per child.
+	// with a reclaim monitor the kills go one by one, every reclaim needs the level to itself.
+	void KillSlots(const std::vector<int>& slots, int timeout_ms, bool graceful = false);
+	void KillAll(int timeout_ms, bool graceful = false) { KillSlots(Slots(), timeout_ms, graceful); }
+
+	// occupied slots, ascending
+	virtual std::vector<int> Slots() const = 0;
+
+	// --reclaim: KillAll reports every kill to monitor
+	void SetReclaimMonitor(ReclaimMonitor* monitor) { _reclaim = monitor; }
+
+	size_t Count() const { return Slots().size(); }
+	const SupervisorStats& Stats() const { return _stats; }
+
+	static std::unique_ptr<ProcessSupervisor> Create(int argc, char** argv);
+	// --threads: slots are threads of the master running render until their stop flag is set
+	static std::unique_ptr<ProcessSupervisor> CreateThreads(std::function<int(const std::atomic<bool>& stop)> render);
+
+protected:
+	// terminate the children in slots all at once and wait for all of them together, at
+	// most timeout_ms in total. reaped or not, they are gone from the slots afterwards.
+	// the default kills them one after the other.
+	virtual void KillWave(const std::vector<int>& slots, int timeout_ms, bool graceful);
+
+	// MonotonicNs() of the moment the last occupant of slot was killed, 0 if it never had one
+	long long FreedAt(int slot) const;
+	void MarkFreed(int slot);
+	// a child signalled its readiness channel (ready) or closed it by dying (!ready)
+	void MarkReady(int slot, long long spawned_at_ns, bool ready);
+
+	SupervisorStats			_stats;
+	std::vector<long long>	_freed_at;
+	ReclaimMonitor*			_reclaim = nullptr;
+};
+
+// ------------------------------
+// child side
+
+// called once the first frame is on screen, reports how long the respawn took and
+// signals the master through the readiness channel
+void NotifyFirstFrame();
+
+// signal the readiness channel (--ready), implemented per backend
+void SignalReady();
+
+// on a render thread (--threads) tell its supervisor instead, false on any other thread
+bool SignalThreadReady();
+
+#ifndef _WIN32
+// zygote: serve fork requests from the master on fd. returns true inside every
+// forked child, and false in the zygote itself once the master hangs up.
+bool ServeZygote(int fd);
+#endif
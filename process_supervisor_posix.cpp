@@ -0,0 +1,679 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "process_supervisor.h"
+#include "settings.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+// pidfd_open has no glibc wrapper before 2.36, and no kernel support before 5.3
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+// children get their end of the readiness pipe as a fixed fd
+static const int kReadyFd = 3;
+
+// make fd show up as target in the spawned process. dup2 drops the cloexec flag, but not
+// when fd already sits on target, so move it out of the way first
+static bool InheritAs(posix_spawn_file_actions_t* actions, int& fd, int target)
+{
+	if (fd == target)
+	{
+		int moved = ::fcntl(fd, F_DUPFD_CLOEXEC, target + 1);
+		if (moved < 0) return false;
+		::close(fd);
+		fd = moved;
+	}
+	return posix_spawn_file_actions_adddup2(actions, fd, target) == 0;
+}
+
+// attach fd to msg as SCM_RIGHTS, control must hold CMSG_SPACE(sizeof(int))
+static void AttachFd(msghdr& msg, char* control, int fd)
+{
+	msg.msg_control = control;
+	msg.msg_controllen = CMSG_SPACE(sizeof(int));
+	cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+}
+
+static int ReceivedFd(msghdr& msg)
+{
+	int fd = -1;
+	cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+	{
+		memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	return fd;
+}
+
+// ------------------------------
+// posix_spawn backend
+
+class PosixProcessSupervisor : public ProcessSupervisor
+{
+public:
+	PosixProcessSupervisor(int argc, char** argv)
+	{
+		char exe[PATH_MAX];
+		ssize_t len = ::readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+		if (len > 0)
+		{
+			exe[len] = 0;
+			_exe = exe;
+		}
+		for (int i = 0; i < argc; ++i) _args.push_back(argv[i]);
+
+		// a pidfd and the readiness pipe per child, hundreds of them don't fit the usual soft limit of 1024
+		rlimit files;
+		rlim_t needed = (rlim_t)kMax_num_process_count * 2 + 64;
+		if (::getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < needed)
+		{
+			files.rlim_cur = std::min(needed, files.rlim_max);
+			::setrlimit(RLIMIT_NOFILE, &files);
+		}
+	}
+
+	~PosixProcessSupervisor()
+	{
+		for (auto& c : _children)
+		{
+			if (c.pidfd >= 0) ::close(c.pidfd);
+			if (c.ready_fd >= 0) ::close(c.ready_fd);
+		}
+	}
+
+	int Spawn() override
+	{
+		ReapLingering();
+
+		int slot = 0;
+		while (Find(slot) != _children.end()) ++slot;
+
+		TraceScope trace("spawn", slot);
+		Child child = { slot, 0, -1, true, MonotonicNs(), -1 };
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!Launch(child))
+		{
+			_stats.spawn_failures++;
+			return -1;
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		_stats.spawned++;
+		_stats.last_spawn_ms = ms;
+		_stats.total_spawn_ms += ms;
+		_children.push_back(child);
+
+		LOG(INFO) << "[" << _instance_name << "] " << "spawned child " << slot << " (pid " << child.pid << ") in " << ms << " ms";
+		return slot;
+	}
+
+	bool Kill(int slot, int timeout_ms, bool graceful) override
+	{
+		auto it = Find(slot);
+		if (it == _children.end()) return false;
+
+		TraceScope trace("kill", slot);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool reaped = false;
+		if (graceful)
+		{
+			::kill(it->pid, SIGTERM);
+			reaped = WaitForExit(*it, timeout_ms / 2);
+		}
+		if (!reaped)
+		{
+			::kill(it->pid, SIGKILL);
+			reaped = WaitForExit(*it, timeout_ms);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		Release(it, reaped, ms, timeout_ms);
+		return reaped;
+	}
+
+	void KillWave(const std::vector<int>& slots, int timeout_ms, bool graceful) override
+	{
+		// signal everyone first, then one epoll over all pidfds, so the wave costs the slowest
+		// child instead of the sum of them
+		int64_t start_ns = MonotonicNs();
+		std::vector<const Child*> wave;
+		for (int slot : slots)
+		{
+			auto it = Find(slot);
+			if (it != _children.end()) wave.push_back(&*it);
+		}
+		std::vector<int64_t> exited_ns(wave.size(), 0);
+		if (graceful)
+		{
+			for (const Child* c : wave) ::kill(c->pid, SIGTERM);
+			WaitForAll(wave, exited_ns, timeout_ms / 2);
+		}
+		for (size_t i = 0; i < wave.size(); ++i)
+		{
+			if (exited_ns[i] == 0) ::kill(wave[i]->pid, SIGKILL);
+		}
+		WaitForAll(wave, exited_ns, timeout_ms);
+
+		std::vector<int> wave_slots;
+		for (const Child* c : wave) wave_slots.push_back(c->slot);
+		int64_t end_ns = MonotonicNs();
+		for (size_t i = 0; i < wave_slots.size(); ++i)
+		{
+			bool reaped = exited_ns[i] != 0;
+			TraceEvent("kill", start_ns, reaped ? exited_ns[i] : end_ns, wave_slots[i]);
+			Release(Find(wave_slots[i]), reaped, NsToMs((reaped ? exited_ns[i] : end_ns) - start_ns), timeout_ms);
+		}
+	}
+
+	int WaitReady(int timeout_ms) override
+	{
+		int ready = 0;
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		std::vector<pollfd> pfds;
+		for (;;)
+		{
+			pfds.clear();
+			for (auto& c : _children)
+			{
+				if (c.ready_fd >= 0) pfds.push_back({ c.ready_fd, POLLIN, 0 });
+			}
+			if (pfds.empty()) break;
+
+			int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			int ret = ::poll(pfds.data(), pfds.size(), std::max(remaining, 0));
+			if (ret <= 0) break;	// timeout, or interrupted by a signal
+
+			for (auto& pfd : pfds)
+			{
+				if (pfd.revents == 0) continue;
+				auto it = std::find_if(_children.begin(), _children.end(), [&pfd](const Child& c) { return c.ready_fd == pfd.fd; });
+
+				// one byte after the first frame, eof when the child died without sending it
+				char byte;
+				ssize_t n;
+				do
+				{
+					n = ::read(it->ready_fd, &byte, 1);
+				} while (n < 0 && errno == EINTR);
+				::close(it->ready_fd);
+				it->ready_fd = -1;
+
+				MarkReady(it->slot, it->spawned_at_ns, n == 1);
+				if (n == 1) ready++;
+			}
+		}
+		return ready;
+	}
+
+	size_t Pending() const override
+	{
+		return std::count_if(_children.begin(), _children.end(), [](const Child& c) { return c.ready_fd >= 0; });
+	}
+
+	std::vector<int> Slots() const override
+	{
+		std::vector<int> slots;
+		for (auto& c : _children) slots.push_back(c.slot);
+		std::sort(slots.begin(), slots.end());
+		return slots;
+	}
+
+protected:
+	struct Child
+	{
+		int			slot;
+		pid_t		pid;
+		int			pidfd;			// -1 when the kernel has no pidfd support
+		bool		ours;			// our own child (waitpid), or forked by someone else
+		long long	spawned_at_ns;
+		int			ready_fd;		// read end of the readiness pipe until the child reported in
+	};
+
+	// start the process for child.slot, fill in pid/pidfd/ready_fd
+	virtual bool Launch(Child& child)
+	{
+		int ready[2];
+		if (::pipe2(ready, O_CLOEXEC) < 0)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "pipe failed (" << strerror(errno) << ")";
+			return false;
+		}
+
+		std::vector<std::string> args = _args;
+		args.push_back("--instance");
+		args.push_back(std::to_string(child.slot));
+		args.push_back("--spawned-at");
+		args.push_back(std::to_string(child.spawned_at_ns));
+		args.push_back("--freed-at");
+		args.push_back(std::to_string(FreedAt(child.slot)));
+		args.push_back("--ready");
+		args.push_back(std::to_string(kReadyFd));
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		bool started = InheritAs(&actions, ready[1], kReadyFd) && SpawnSelf(args, &actions, child.pid);
+		posix_spawn_file_actions_destroy(&actions);
+		::close(ready[1]);	// only the child holds the write end now, so its death reads as eof
+
+		if (!started)
+		{
+			::close(ready[0]);
+			return false;
+		}
+		child.pidfd = open_pidfd(child.pid);
+		child.ready_fd = ready[0];
+		return true;
+	}
+
+	// children re-run our own command line, plus who their master is
+	bool SpawnSelf(std::vector<std::string> args, const posix_spawn_file_actions_t* actions, pid_t& pid)
+	{
+		args.push_back("--session");
+		args.push_back(std::to_string(::getpid()));
+
+		std::vector<char*> argv;
+		for (auto& a : args) argv.push_back(&a[0]);
+		argv.push_back(nullptr);
+
+		int err = _exe.empty()
+			? ::posix_spawnp(&pid, argv[0], actions, nullptr, argv.data(), environ)
+			: ::posix_spawn(&pid, _exe.c_str(), actions, nullptr, argv.data(), environ);
+		if (err != 0)
+		{
+			LOG(ERROR) << "posix_spawn failed (" << strerror(err) << ")";
+			return false;
+		}
+		return true;
+	}
+
+	std::vector<Child>::iterator Find(int slot)
+	{
+		return std::find_if(_children.begin(), _children.end(), [slot](const Child& c) { return c.slot == slot; });
+	}
+
+	// book the kill of the child at it and free its slot
+	void Release(std::vector<Child>::iterator it, bool reaped, double ms, int timeout_ms)
+	{
+		if (reaped)
+		{
+			_stats.reaped++;
+			_stats.last_reap_ms = ms;
+			_stats.total_reap_ms += ms;
+		}
+		else
+		{
+			// stuck in the kernel (most likely inside the driver), collect it later
+			_stats.reap_timeouts++;
+			if (it->ours) _lingering.push_back(it->pid);
+			LOG(WARNING) << "[" << _instance_name << "] " << "child " << it->slot << " (pid " << it->pid << ") still alive after " << timeout_ms << " ms";
+		}
+
+		int slot = it->slot;
+		if (it->pidfd >= 0) ::close(it->pidfd);
+		if (it->ready_fd >= 0) ::close(it->ready_fd);
+		_children.erase(it);
+		MarkFreed(slot);
+	}
+
+	// without a pidfd: reap it if it's ours, or see whether it's still there
+	static bool Exited(const Child& c)
+	{
+		int status = 0;
+		if (c.ours) return ::waitpid(c.pid, &status, WNOHANG) == c.pid;
+		return ::kill(c.pid, 0) < 0 && errno == ESRCH;
+	}
+
+	// wait up to timeout_ms for every child of wave that hasn't exited yet, exited_ns gets
+	// the MonotonicNs() each one was seen gone at. pidfds go into one epoll set, children
+	// without one (no kernel support) are polled in between
+	void WaitForAll(const std::vector<const Child*>& wave, std::vector<int64_t>& exited_ns, int timeout_ms)
+	{
+		int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+		size_t left = 0;
+		bool polled = false;
+		std::vector<bool> watched(wave.size(), false);
+		for (size_t i = 0; i < wave.size(); ++i)
+		{
+			if (exited_ns[i] != 0) continue;
+			left++;
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.u64 = i;
+			watched[i] = wave[i]->pidfd >= 0 && epfd >= 0 && ::epoll_ctl(epfd, EPOLL_CTL_ADD, wave[i]->pidfd, &event) == 0;
+			if (!watched[i]) polled = true;
+		}
+
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		std::vector<epoll_event> events(64);
+		while (left > 0)
+		{
+			int remaining = std::max((int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count(), 0);
+			int n = 0;
+			if (epfd >= 0)
+			{
+				n = ::epoll_wait(epfd, events.data(), (int)events.size(), polled ? std::min(remaining, 1) : remaining);
+				if (n < 0 && errno != EINTR) break;
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(250));
+			}
+			int64_t now = MonotonicNs();
+			for (int e = 0; e < n; ++e)
+			{
+				size_t i = (size_t)events[e].data.u64;
+				int status = 0;
+				if (wave[i]->ours) ::waitpid(wave[i]->pid, &status, 0);	// the pidfd is readable, this doesn't block
+				::epoll_ctl(epfd, EPOLL_CTL_DEL, wave[i]->pidfd, nullptr);
+				exited_ns[i] = now;
+				left--;
+			}
+			if (polled)
+			{
+				for (size_t i = 0; i < wave.size(); ++i)
+				{
+					if (exited_ns[i] != 0 || watched[i]) continue;
+					if (!Exited(*wave[i])) continue;
+					exited_ns[i] = now;
+					left--;
+				}
+			}
+			if (remaining == 0) break;
+		}
+		if (epfd >= 0) ::close(epfd);
+	}
+
+	bool WaitForExit(const Child& c, int timeout_ms)
+	{
+		int status = 0;
+		if (c.pidfd >= 0)
+		{
+			// the pidfd turns readable once the child has exited, the waitpid is then immediate
+			pollfd pfd = { c.pidfd, POLLIN, 0 };
+			int ret;
+			do
+			{
+				ret = ::poll(&pfd, 1, timeout_ms);
+			} while (ret < 0 && errno == EINTR);
+			if (ret <= 0) return false;
+			return !c.ours || ::waitpid(c.pid, &status, 0) == c.pid;
+		}
+
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		for (;;)
+		{
+			if (c.ours)
+			{
+				pid_t ret = ::waitpid(c.pid, &status, WNOHANG);
+				if (ret == c.pid) return true;
+				if (ret < 0) return false;
+			}
+			else if (::kill(c.pid, 0) < 0 && errno == ESRCH)
+			{
+				return true;
+			}
+			if (std::chrono::steady_clock::now() >= deadline) return false;
+			std::this_thread::sleep_for(std::chrono::microseconds(250));
+		}
+	}
+
+	void ReapLingering()
+	{
+		int status = 0;
+		_lingering.erase(std::remove_if(_lingering.begin(), _lingering.end(),
+			[&status](pid_t pid) { return ::waitpid(pid, &status, WNOHANG) != 0; }), _lingering.end());
+	}
+
+	std::string					_exe;
+	std::vector<std::string>	_args;
+	std::vector<Child>			_children;
+	std::vector<pid_t>			_lingering;	// killed but not reaped within the timeout
+};
+
+// ------------------------------
+// zygote backend: one warm template process forks the children on request.
+// the zygote reaps them itself, we only watch them through pidfds it hands back.
+
+static const int kZygoteControlFd = 3;
+
+struct ZygoteRequest
+{
+	int			slot;
+	long long	spawned_at_ns;
+	long long	freed_at_ns;
+};
+
+struct ZygoteReply
+{
+	pid_t		pid;	// <= 0 when the fork failed
+};
+
+class ZygoteProcessSupervisor : public PosixProcessSupervisor
+{
+public:
+	ZygoteProcessSupervisor(int argc, char** argv)
+		: PosixProcessSupervisor(argc, argv)
+	{
+		int sv[2];
+		if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "zygote: socketpair failed (" << strerror(errno) << ")";
+			return;
+		}
+
+		// the zygote gets its end of the socket as a fixed fd
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+
+		std::vector<std::string> args = _args;
+		args.push_back("--zygote-fd");
+		args.push_back(std::to_string(kZygoteControlFd));
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool started = InheritAs(&actions, sv[1], kZygoteControlFd) && SpawnSelf(args, &actions, _zygote);
+		posix_spawn_file_actions_destroy(&actions);
+		::close(sv[1]);
+
+		if (!started)
+		{
+			::close(sv[0]);
+			return;
+		}
+		_control = sv[0];
+		LOG(INFO) << "[" << _instance_name << "] " << "zygote started (pid " << _zygote << ") in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms";
+	}
+
+	~ZygoteProcessSupervisor()
+	{
+		if (_control >= 0) ::close(_control);	// the zygote exits once its socket hangs up
+		if (_zygote > 0)
+		{
+			::kill(_zygote, SIGKILL);
+			int status = 0;
+			::waitpid(_zygote, &status, 0);
+		}
+	}
+
+protected:
+	bool Launch(Child& child) override
+	{
+		if (_control < 0) return false;
+
+		int ready[2];
+		if (::pipe2(ready, O_CLOEXEC) < 0)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "pipe failed (" << strerror(errno) << ")";
+			return false;
+		}
+
+		// the write end of the readiness pipe travels along with the request
+		ZygoteRequest request = { child.slot, child.spawned_at_ns, FreedAt(child.slot) };
+		char request_control[CMSG_SPACE(sizeof(int))] = {};
+		iovec request_iov = { &request, sizeof(request) };
+		msghdr request_msg = {};
+		request_msg.msg_iov = &request_iov;
+		request_msg.msg_iovlen = 1;
+		AttachFd(request_msg, request_control, ready[1]);
+
+		ssize_t sent = ::sendmsg(_control, &request_msg, MSG_NOSIGNAL);
+		::close(ready[1]);
+		if (sent != sizeof(request))
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "zygote: request failed (" << strerror(errno) << ")";
+			::close(ready[0]);
+			return false;
+		}
+
+		ZygoteReply reply = {};
+		char control[CMSG_SPACE(sizeof(int))] = {};
+		iovec iov = { &reply, sizeof(reply) };
+		msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t n;
+		do
+		{
+			n = ::recvmsg(_control, &msg, MSG_CMSG_CLOEXEC);
+		} while (n < 0 && errno == EINTR);
+		if (n != sizeof(reply) || reply.pid <= 0)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "zygote: fork failed";
+			::close(ready[0]);
+			return false;
+		}
+
+		child.pid = reply.pid;
+		child.ours = false;
+		child.pidfd = ReceivedFd(msg);
+		child.ready_fd = ready[0];
+		return true;
+	}
+
+private:
+	pid_t	_zygote = 0;
+	int		_control = -1;
+};
+
+std::unique_ptr<ProcessSupervisor> ProcessSupervisor::Create(int argc, char** argv)
+{
+	if (kZygote)
+	{
+		return std::make_unique<ZygoteProcessSupervisor>(argc, argv);
+	}
+	return std::make_unique<PosixProcessSupervisor>(argc, argv);
+}
+
+// ------------------------------
+// zygote side
+
+bool ServeZygote(int fd)
+{
+	// forked children are reaped automatically, the master watches them through their pidfds
+	struct sigaction sa = {};
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGCHLD, &sa, nullptr);
+
+	for (;;)
+	{
+		ZygoteRequest request;
+		char request_control[CMSG_SPACE(sizeof(int))] = {};
+		iovec request_iov = { &request, sizeof(request) };
+		msghdr request_msg = {};
+		request_msg.msg_iov = &request_iov;
+		request_msg.msg_iovlen = 1;
+		request_msg.msg_control = request_control;
+		request_msg.msg_controllen = sizeof(request_control);
+
+		ssize_t n = ::recvmsg(fd, &request_msg, MSG_CMSG_CLOEXEC);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;	// the master hung up
+		int ready_fd = ReceivedFd(request_msg);
+		if (n != sizeof(request))
+		{
+			if (ready_fd >= 0) ::close(ready_fd);
+			continue;
+		}
+
+		pid_t pid = ::fork();
+		if (pid == 0)
+		{
+			sa.sa_handler = SIG_DFL;
+			sigaction(SIGCHLD, &sa, nullptr);
+			::close(fd);
+
+			kInstance_slot = request.slot;
+			kSpawned_at_ns = request.spawned_at_ns;
+			kSlot_freed_at_ns = request.freed_at_ns;
+			kZygote_fd = -1;
+			kReady_handle = ready_fd;
+			return true;
+		}
+		if (ready_fd >= 0) ::close(ready_fd);	// the child holds the only write end now
+
+		ZygoteReply reply = { pid };
+		int pidfd = pid > 0 ? open_pidfd(pid) : -1;
+
+		char control[CMSG_SPACE(sizeof(int))] = {};
+		iovec iov = { &reply, sizeof(reply) };
+		msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		if (pidfd >= 0) AttachFd(msg, control, pidfd);
+		::sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (pidfd >= 0) ::close(pidfd);
+	}
+}
+
+// ------------------------------
+// child side
+
+void SignalReady()
+{
+	if (kReady_handle < 0) return;
+
+	char byte = 1;
+	ssize_t n;
+	do
+	{
+		n = ::write(kReady_handle, &byte, 1);
+	} while (n < 0 && errno == EINTR);
+	::close(kReady_handle);
+	kReady_handle = -1;
+}
@@ -0,0 +1,289 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "process_supervisor.h"
+#include "settings.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+// ------------------------------
+// render thread backend (--threads): a slot is a thread of the master with a context
+// of its own, killing it means asking it to stop and waiting until it destroyed that
+// context. the child's per slot settings are thread_local, the thread sets them up
+// the way a child process parses them from its command line.
+
+class ThreadSupervisor;
+
+enum class RenderThreadState
+{
+	Starting,
+	Ready,		// presented its first frame
+	Exited,
+};
+
+struct RenderThread
+{
+	ThreadSupervisor*	owner;
+	int					slot;
+	long long			spawned_at_ns;
+	long long			freed_at_ns;
+	std::atomic<bool>	stop{ false };
+	RenderThreadState	state = RenderThreadState::Starting;	// under the owner's mutex
+	bool				presented = false;
+	bool				reported = false;	// MarkReady done
+	std::thread			thread;
+};
+
+// the render thread running on this thread, null everywhere else
+static thread_local RenderThread* _current = nullptr;
+
+class ThreadSupervisor : public ProcessSupervisor
+{
+public:
+	explicit ThreadSupervisor(std::function<int(const std::atomic<bool>& stop)> render)
+		: _render(std::move(render))
+	{
+	}
+
+	~ThreadSupervisor()
+	{
+		// a thread can't be killed, one stuck in the driver holds up the exit like a process would
+		for (auto& t : _threads) t->stop.store(true);
+		for (auto& t : _lingering) t->stop.store(true);
+		for (auto& t : _threads) t->thread.join();
+		for (auto& t : _lingering) t->thread.join();
+	}
+
+	int Spawn() override
+	{
+		ReapLingering();
+
+		int slot = 0;
+		while (Find(slot) != _threads.end()) ++slot;
+
+		TraceScope trace("spawn", slot);
+		std::unique_ptr<RenderThread> t = std::make_unique<RenderThread>();
+		t->owner = this;
+		t->slot = slot;
+		t->spawned_at_ns = MonotonicNs();
+		t->freed_at_ns = FreedAt(slot);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		try
+		{
+			t->thread = std::thread(&ThreadSupervisor::Run, this, t.get());
+		}
+		catch (const std::system_error& e)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "render thread " << slot << " failed to start (" << e.what() << ")";
+			_stats.spawn_failures++;
+			return -1;
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		_stats.spawned++;
+		_stats.last_spawn_ms = ms;
+		_stats.total_spawn_ms += ms;
+		_threads.push_back(std::move(t));
+
+		LOG(INFO) << "[" << _instance_name << "] " << "spawned render thread " << slot << " in " << ms << " ms";
+		return slot;
+	}
+
+	bool Kill(int slot, int timeout_ms, bool graceful) override
+	{
+		(void)graceful;		// a thread always stops cooperatively
+		auto it = Find(slot);
+		if (it == _threads.end()) return false;
+
+		TraceScope trace("kill", slot);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RenderThread& t = **it;
+		t.stop.store(true);
+		bool exited;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			exited = _changed.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&t] { return t.state == RenderThreadState::Exited; });
+		}
+		if (exited) t.thread.join();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		Release(it, exited, ms, timeout_ms);
+		return exited;
+	}
+
+	void KillWave(const std::vector<int>& slots, int timeout_ms, bool graceful) override
+	{
+		(void)graceful;
+		int64_t start_ns = MonotonicNs();
+		std::vector<RenderThread*> wave;
+		for (int slot : slots)
+		{
+			auto it = Find(slot);
+			if (it == _threads.end()) continue;
+			(*it)->stop.store(true);
+			wave.push_back(it->get());
+		}
+
+		// every thread tears its context down at the same time, note each one as it's done
+		std::vector<int64_t> exited_ns(wave.size(), 0);
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			for (;;)
+			{
+				size_t left = 0;
+				for (size_t i = 0; i < wave.size(); ++i)
+				{
+					if (exited_ns[i] != 0) continue;
+					if (wave[i]->state == RenderThreadState::Exited) exited_ns[i] = MonotonicNs();
+					else left++;
+				}
+				if (left == 0 || _changed.wait_until(lock, deadline) == std::cv_status::timeout) break;
+			}
+		}
+
+		int64_t end_ns = MonotonicNs();
+		for (size_t i = 0; i < wave.size(); ++i)
+		{
+			bool exited = exited_ns[i] != 0;
+			if (exited) wave[i]->thread.join();
+			TraceEvent("kill", start_ns, exited ? exited_ns[i] : end_ns, wave[i]->slot);
+			Release(Find(wave[i]->slot), exited, NsToMs((exited ? exited_ns[i] : end_ns) - start_ns), timeout_ms);
+		}
+	}
+
+	int WaitReady(int timeout_ms) override
+	{
+		int ready = 0;
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		std::unique_lock<std::mutex> lock(_mutex);
+		for (;;)
+		{
+			bool pending = false;
+			for (auto& t : _threads)
+			{
+				if (t->reported) continue;
+				if (t->state == RenderThreadState::Starting)
+				{
+					pending = true;
+					continue;
+				}
+				t->reported = true;
+				MarkReady(t->slot, t->spawned_at_ns, t->presented);
+				if (t->presented) ready++;
+			}
+			if (!pending || _changed.wait_until(lock, deadline) == std::cv_status::timeout) break;
+		}
+		return ready;
+	}
+
+	size_t Pending() const override
+	{
+		return std::count_if(_threads.begin(), _threads.end(), [](const std::unique_ptr<RenderThread>& t) { return !t->reported; });
+	}
+
+	std::vector<int> Slots() const override
+	{
+		std::vector<int> slots;
+		for (auto& t : _threads) slots.push_back(t->slot);
+		std::sort(slots.begin(), slots.end());
+		return slots;
+	}
+
+	void SetState(RenderThread& t, RenderThreadState state)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (state == RenderThreadState::Ready) t.presented = true;
+			t.state = state;
+		}
+		_changed.notify_all();
+	}
+
+private:
+	// book the kill of the thread at it and free its slot
+	void Release(std::vector<std::unique_ptr<RenderThread>>::iterator it, bool exited, double ms, int timeout_ms)
+	{
+		int slot = (*it)->slot;
+		if (exited)
+		{
+			_stats.reaped++;
+			_stats.last_reap_ms = ms;
+			_stats.total_reap_ms += ms;
+		}
+		else
+		{
+			// most likely inside the driver, joined once it comes back
+			_stats.reap_timeouts++;
+			_lingering.push_back(std::move(*it));
+			LOG(WARNING) << "[" << _instance_name << "] " << "render thread " << slot << " still running after " << timeout_ms << " ms";
+		}
+
+		_threads.erase(it);
+		MarkFreed(slot);
+	}
+
+	void Run(RenderThread* t)
+	{
+		kInstance_slot = t->slot;
+		kSpawned_at_ns = t->spawned_at_ns;
+		kSlot_freed_at_ns = t->freed_at_ns;
+		kReady_handle = -1;
+		_instance_name = std::to_string(t->slot);
+		_current = t;
+		LOG(INFO) << "[" << _instance_name << "] " << " started.";
+
+		int ret = _render(t->stop);
+		LOG(INFO) << "[" << _instance_name << "] " << " exiting" << (ret != 0 ? " (failed)." : ".");
+
+		_current = nullptr;
+		SetState(*t, RenderThreadState::Exited);
+	}
+
+	std::vector<std::unique_ptr<RenderThread>>::iterator Find(int slot)
+	{
+		return std::find_if(_threads.begin(), _threads.end(), [slot](const std::unique_ptr<RenderThread>& t) { return t->slot == slot; });
+	}
+
+	void ReapLingering()
+	{
+		std::vector<std::unique_ptr<RenderThread>> exited;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = std::stable_partition(_lingering.begin(), _lingering.end(),
+				[](const std::unique_ptr<RenderThread>& t) { return t->state != RenderThreadState::Exited; });
+			std::move(it, _lingering.end(), std::back_inserter(exited));
+			_lingering.erase(it, _lingering.end());
+		}
+		for (auto& t : exited) t->thread.join();
+	}
+
+	std::function<int(const std::atomic<bool>& stop)>	_render;
+	std::mutex									_mutex;
+	std::condition_variable						_changed;
+	std::vector<std::unique_ptr<RenderThread>>	_threads;
+	std::vector<std::unique_ptr<RenderThread>>	_lingering;	// stopped but not exited within the timeout
+};
+
+std::unique_ptr<ProcessSupervisor> ProcessSupervisor::CreateThreads(std::function<int(const std::atomic<bool>& stop)> render)
+{
+	return std::make_unique<ThreadSupervisor>(std::move(render));
+}
+
+bool SignalThreadReady()
+{
+	if (_current == nullptr) return false;
+	_current->owner->SetState(*_current, RenderThreadState::Ready);
+	return true;
+}
@@ -0,0 +1,284 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "process_supervisor.h"
+#include "settings.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+// children open the readiness event by name, unique per master and per spawn
+static std::string ReadyEventName(int session, int token)
+{
+	return "Local\\OutofProcWindowReady_" + std::to_string(session) + "_" + std::to_string(token);
+}
+
+class Win32ProcessSupervisor : public ProcessSupervisor
+{
+public:
+	~Win32ProcessSupervisor()
+	{
+		for (auto& c : _children)
+		{
+			::CloseHandle(c.pi.hThread);
+			::CloseHandle(c.pi.hProcess);
+			if (c.ready) ::CloseHandle(c.ready);
+		}
+	}
+
+	int Spawn() override
+	{
+		int slot = 0;
+		while (Find(slot) != _children.end()) ++slot;
+
+		TraceScope trace("spawn", slot);
+		// manual reset, the child sets it after its first SwapBuffers
+		int token = _next_token++;
+		HANDLE ready = ::CreateEventA(NULL, TRUE, FALSE, ReadyEventName(::GetCurrentProcessId(), token).c_str());
+		if (ready == NULL)
+		{
+			LOG(ERROR) << "CreateEvent failed (" << GetLastError() << ")";
+			_stats.spawn_failures++;
+			return -1;
+		}
+
+		// children re-run our own command line, plus their slot and who their master is
+		long long spawned_at_ns = MonotonicNs();
+		std::string cmdline = ::GetCommandLineA();
+		cmdline += " --instance " + std::to_string(slot) + " --session " + std::to_string(::GetCurrentProcessId());
+		cmdline += " --spawned-at " + std::to_string(spawned_at_ns) + " --freed-at " + std::to_string(FreedAt(slot));
+		cmdline += " --ready " + std::to_string(token);
+
+		STARTUPINFO si;
+		PROCESS_INFORMATION pi;
+
+		ZeroMemory(&si, sizeof(si));
+		si.cb = sizeof(si);
+		ZeroMemory(&pi, sizeof(pi));
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!CreateProcess(NULL,   // No module name (use command line)
+			&cmdline[0],    // Command line
+			NULL,           // Process handle not inheritable
+			NULL,           // Thread handle not inheritable
+			FALSE,          // Set handle inheritance to FALSE
+			0,              // No creation flags
+			NULL,           // Use parent's environment block
+			NULL,           // Use parent's starting directory 
+			&si,            // Pointer to STARTUPINFO structure
+			&pi)           // Pointer to PROCESS_INFORMATION structure
+			)
+		{
+			LOG(ERROR) << "CreateProcess failed (" << GetLastError() << ")";
+			::CloseHandle(ready);
+			_stats.spawn_failures++;
+			return -1;
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		_stats.spawned++;
+		_stats.last_spawn_ms = ms;
+		_stats.total_spawn_ms += ms;
+		_children.push_back({ slot, pi, spawned_at_ns, ready });
+
+		LOG(INFO) << "[" << _instance_name << "] " << "spawned child " << slot << " (pid " << pi.dwProcessId << ") in " << ms << " ms";
+		return slot;
+	}
+
+	bool Kill(int slot, int timeout_ms, bool graceful) override
+	{
+		UNREFERENCED_PARAMETER(graceful); // there is no polite way to ask, children get terminated either way
+
+		auto it = Find(slot);
+		if (it == _children.end()) return false;
+
+		TraceScope trace("kill", slot);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		::TerminateProcess(it->pi.hProcess, 0);
+		bool reaped = WaitForSingleObject(it->pi.hProcess, timeout_ms) == WAIT_OBJECT_0;
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		Release(it, reaped, ms, timeout_ms);
+		return reaped;
+	}
+
+	void KillWave(const std::vector<int>& slots, int timeout_ms, bool graceful) override
+	{
+		UNREFERENCED_PARAMETER(graceful);
+
+		// terminate everyone first, then wait on the process handles. a wait only reports the
+		// lowest signalled handle and covers MAXIMUM_WAIT_OBJECTS of them, so every pass sweeps
+		// all pending children without blocking and notes everyone that is gone
+		int64_t start_ns = MonotonicNs();
+		std::vector<int> pending;
+		for (int slot : slots)
+		{
+			auto it = Find(slot);
+			if (it == _children.end()) continue;
+			::TerminateProcess(it->pi.hProcess, 0);
+			pending.push_back(slot);
+		}
+
+		std::vector<std::pair<int, int64_t>> exited;
+		ULONGLONG deadline = ::GetTickCount64() + timeout_ms;
+		for (;;)
+		{
+			// also the last look at a child before it's released as unreaped
+			int64_t now_ns = MonotonicNs();
+			for (size_t i = 0; i < pending.size();)
+			{
+				if (::WaitForSingleObject(Find(pending[i])->pi.hProcess, 0) == WAIT_OBJECT_0)
+				{
+					exited.emplace_back(pending[i], now_ns);
+					pending.erase(pending.begin() + i);
+				}
+				else ++i;
+			}
+			ULONGLONG now = ::GetTickCount64();
+			if (pending.empty() || now >= deadline) break;
+
+			// block on the first window, in short slices when there are more so theirs get swept too
+			std::vector<HANDLE> handles;
+			for (size_t i = 0; i < pending.size() && handles.size() < MAXIMUM_WAIT_OBJECTS; ++i) handles.push_back(Find(pending[i])->pi.hProcess);
+			DWORD remaining = (DWORD)(deadline - now);
+			if (pending.size() > MAXIMUM_WAIT_OBJECTS && remaining > 1) remaining = 1;
+			if (::WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, remaining) == WAIT_FAILED) break;
+		}
+
+		for (auto& e : exited)
+		{
+			TraceEvent("kill", start_ns, e.second, e.first);
+			Release(Find(e.first), true, NsToMs(e.second - start_ns), timeout_ms);
+		}
+		int64_t end_ns = MonotonicNs();
+		for (int slot : pending)
+		{
+			TraceEvent("kill", start_ns, end_ns, slot);
+			Release(Find(slot), false, NsToMs(end_ns - start_ns), timeout_ms);
+		}
+	}
+
+	int WaitReady(int timeout_ms) override
+	{
+		int ready = 0;
+		ULONGLONG deadline = ::GetTickCount64() + timeout_ms;
+		for (;;)
+		{
+			// the readiness event and the process handle of every pending child, so a child
+			// that dies early doesn't keep us waiting. MsgWait takes one slot for the message queue
+			std::vector<HANDLE> handles;
+			std::vector<int> slots;
+			for (auto& c : _children)
+			{
+				if (c.ready == NULL || handles.size() + 2 > MAXIMUM_WAIT_OBJECTS - 1) continue;
+				handles.push_back(c.ready);
+				handles.push_back(c.pi.hProcess);
+				slots.push_back(c.slot);
+			}
+			if (handles.empty()) break;
+
+			ULONGLONG now = ::GetTickCount64();
+			DWORD remaining = now < deadline ? (DWORD)(deadline - now) : 0;
+			DWORD ret = ::MsgWaitForMultipleObjectsEx((DWORD)handles.size(), handles.data(), remaining, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+			if (ret >= WAIT_OBJECT_0 + handles.size()) break;	// window messages, timeout or failure
+
+			// the wait reports the lowest signalled handle, sweep the rest without blocking
+			for (size_t i = 0; i < slots.size(); ++i)
+			{
+				bool signalled = ::WaitForSingleObject(handles[i * 2], 0) == WAIT_OBJECT_0;
+				bool exited = ::WaitForSingleObject(handles[i * 2 + 1], 0) == WAIT_OBJECT_0;
+				if (!signalled && !exited) continue;
+
+				auto it = Find(slots[i]);
+				::CloseHandle(it->ready);
+				it->ready = NULL;
+				MarkReady(it->slot, it->spawned_at_ns, signalled);
+				if (signalled) ready++;
+			}
+		}
+		return ready;
+	}
+
+	size_t Pending() const override
+	{
+		return std::count_if(_children.begin(), _children.end(), [](const Child& c) { return c.ready != NULL; });
+	}
+
+	std::vector<int> Slots() const override
+	{
+		std::vector<int> slots;
+		for (auto& c : _children) slots.push_back(c.slot);
+		std::sort(slots.begin(), slots.end());
+		return slots;
+	}
+
+private:
+	struct Child
+	{
+		int					slot;
+		PROCESS_INFORMATION	pi;
+		long long			spawned_at_ns;
+		HANDLE				ready;		// readiness event until the child reported in
+	};
+
+	std::vector<Child>::iterator Find(int slot)
+	{
+		return std::find_if(_children.begin(), _children.end(), [slot](const Child& c) { return c.slot == slot; });
+	}
+
+	// book the kill of the child at it and free its slot
+	void Release(std::vector<Child>::iterator it, bool reaped, double ms, int timeout_ms)
+	{
+		if (reaped)
+		{
+			_stats.reaped++;
+			_stats.last_reap_ms = ms;
+			_stats.total_reap_ms += ms;
+		}
+		else
+		{
+			_stats.reap_timeouts++;
+			LOG(WARNING) << "[" << _instance_name << "] " << "child " << it->slot << " (pid " << it->pi.dwProcessId << ") still alive after " << timeout_ms << " ms";
+		}
+
+		int slot = it->slot;
+		::CloseHandle(it->pi.hThread);
+		::CloseHandle(it->pi.hProcess);
+		if (it->ready) ::CloseHandle(it->ready);
+		_children.erase(it);
+		MarkFreed(slot);
+	}
+
+	std::vector<Child>	_children;
+	int					_next_token = 0;
+};
+
+std::unique_ptr<ProcessSupervisor> ProcessSupervisor::Create(int argc, char** argv)
+{
+	UNREFERENCED_PARAMETER(argc); // CreateProcess takes the raw command line instead
+	UNREFERENCED_PARAMETER(argv);
+	return std::make_unique<Win32ProcessSupervisor>();
+}
+
+// ------------------------------
+// child side
+
+void SignalReady()
+{
+	if (kReady_handle < 0) return;
+
+	HANDLE ready = ::OpenEventA(EVENT_MODIFY_STATE, FALSE, ReadyEventName(kSession_id, kReady_handle).c_str());
+	if (ready != NULL)
+	{
+		::SetEvent(ready);
+		::CloseHandle(ready);
+	}
+	else
+	{
+		LOG(WARNING) << "[" << _instance_name << "] " << "readiness event not found (" << GetLastError() << ")";
+	}
+	kReady_handle = -1;
+}
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "reclaim_monitor.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static const int64_t kSampleIntervalUs = 250;
+static const int64_t kSettleNs = 100000000ll;		// no move for 100 ms
+static const int64_t kSystemSettleNs = 1200000000ll;	// linux folds per cpu page counts into MemAvailable once a second
+static const int64_t kGiveUpNs = 5000000000ll;		// after the kill
+
+static double ToMb(int64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+bool ReclaimMonitor::Init()
+{
+	if (!_probe.Init())
+	{
+		LOG(WARNING) << "[" << _instance_name << "] " << "reclaim: no memory source, nothing to measure";
+		return false;
+	}
+	_idle = _probe.Sample();
+	LOG(INFO) << "[" << _instance_name << "] " << "reclaim: sampling " << _probe.SourceName() << ", idle level " << ToMb(_idle) << "mb";
+	return true;
+}
+
+void ReclaimMonitor::BeginWave(size_t children, size_t victims)
+{
+	if (_probe.Source() == MemorySource::None) return;
+	_before = _probe.Sample();
+	_footprint = children > 0 ? (_before - _idle) / (int64_t)children : 0;
+	_victims = victims;
+	_kill_ns = MonotonicNs();
+}
+
+void ReclaimMonitor::EndWave()
+{
+	if (_probe.Source() == MemorySource::None || _victims == 0) return;
+
+	// the level counts as moved only past the noise of the source, the rest of the
+	// system allocates out of the same pool when it's system memory
+	bool system = _probe.Source() == MemorySource::System;
+	const int64_t tolerance = system ? 1024 * 1024 : 256 * 1024;
+	const int64_t settle_ns = system ? kSystemSettleNs : kSettleNs;
+	int64_t level = _probe.Sample();
+	int64_t changed_ns = MonotonicNs();
+	size_t samples = 1;
+	bool settled = false;
+	for (;;)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(kSampleIntervalUs));
+		int64_t value = _probe.Sample();
+		int64_t now = MonotonicNs();
+		samples++;
+		if (std::llabs(value - level) > tolerance)
+		{
+			level = value;
+			changed_ns = now;
+		}
+		if (now - changed_ns >= settle_ns)
+		{
+			settled = true;
+			break;
+		}
+		if (now - _kill_ns >= kGiveUpNs) break;
+	}
+
+	double latency_ms = NsToMs(changed_ns - _kill_ns);
+	int64_t reclaimed = _before - level;
+	int64_t leaked = _footprint * (int64_t)_victims - reclaimed;
+	_stats.waves++;
+	_stats.kills += _victims;
+	_stats.unsettled += settled ? 0 : 1;
+	_stats.total_latency_ms += latency_ms;
+	_stats.worst_latency_ms = std::max(_stats.worst_latency_ms, latency_ms);
+	_stats.total_leaked += leaked;
+	LOG(INFO) << "[" << _instance_name << "] " << "reclaim: " << _victims << " kills, " << ToMb(reclaimed) << "mb back " << latency_ms << " ms after the kill"
+		<< (settled ? "" : " (still moving)") << ", " << ToMb(leaked) << "mb of their " << ToMb(_footprint * (int64_t)_victims) << "mb leaked, " << samples << " samples, "
+		<< ToMb(level - _idle) << "mb above idle (" << ToMb(_stats.total_leaked) << "mb leaked over " << _stats.kills << " kills)";
+	_victims = 0;
+}
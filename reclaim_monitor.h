@@ -0,0 +1,49 @@
+#pragma once
+
+#include "memory_probe.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------
+// reclaim monitor (--reclaim): samples the memory probe right before a kill wave and
+// then every fraction of a millisecond until the level holds still, to see how long
+// the driver takes to hand back what the children held and what it never does.
+// the victims of a wave are killed together and settle together, so a wave pays one
+// settle window and the respawn cadence stays close to a run without --reclaim.
+// a child's footprint is estimated per kill wave as (level with every child up -
+// level before the first spawn) / children, and whatever of the victims' didn't come
+// back by the time the level settled counts as leaked.
+
+struct ReclaimStats
+{
+	size_t		waves = 0;
+	size_t		kills = 0;
+	size_t		unsettled = 0;		// waves still moving when the sampling gave up
+	double		total_latency_ms = 0;	// per wave, kill -> level settled
+	double		worst_latency_ms = 0;
+	int64_t		total_leaked = 0;	// bytes, can go negative with a noisy source
+};
+
+class ReclaimMonitor
+{
+public:
+	// pick the source and take the idle level, before any child is spawned
+	bool	Init();
+
+	// around killing and reaping a wave of victims, children is how many are up before it
+	// (the footprint is their mean). EndWave returns once the level settled
+	void	BeginWave(size_t children, size_t victims);
+	void	EndWave();
+
+	const ReclaimStats&	Stats() const { return _stats; }
+
+private:
+	MemoryProbe		_probe;
+	int64_t			_idle = 0;			// before the first spawn
+	int64_t			_footprint = 0;		// per child, this wave
+	size_t			_victims = 0;
+	int64_t			_before = 0;
+	int64_t			_kill_ns = 0;
+	ReclaimStats	_stats;
+};
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+#include "respawn_scheduler.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <chrono>
+
+RespawnScheduler::RespawnScheduler(RespawnPolicy policy, int period_s, int count, unsigned long long seed)
+	: _policy(policy)
+	, _period_ns((int64_t)period_s * 1000000000ll)
+	, _mean_ns(_period_ns / std::max(count, 1))
+	, _seed(seed != 0 ? seed : (unsigned long long)std::chrono::system_clock::now().time_since_epoch().count())
+	, _random(_seed)
+{
+	_next_ns = MonotonicNs() + Interval();
+}
+
+int64_t RespawnScheduler::Interval()
+{
+	switch (_policy)
+	{
+	case RespawnPolicy::Rolling:
+		return _mean_ns;
+	case RespawnPolicy::Poisson:
+		return std::max<int64_t>((int64_t)std::exponential_distribution<double>(1.0 / _mean_ns)(_random), 1);
+	default:
+		// as the churn always did it: once the whole seconds since the last wave exceed the period
+		return _period_ns + 1000000000ll;
+	}
+}
+
+std::vector<int> RespawnScheduler::Due(int64_t now_ns, const std::vector<int>& slots)
+{
+	std::vector<int> victims;
+	if (now_ns < _next_ns) return victims;
+
+	switch (_policy)
+	{
+	case RespawnPolicy::Rolling:
+		// the next slot after the last one killed, which is the child up the longest
+		if (!slots.empty())
+		{
+			auto next = std::upper_bound(slots.begin(), slots.end(), _last_slot);
+			_last_slot = next != slots.end() ? *next : slots.front();
+			victims.push_back(_last_slot);
+		}
+		// a kill that came late doesn't pull the ones after it forward
+		_next_ns += _mean_ns;
+		if (_next_ns <= now_ns) _next_ns = now_ns + _mean_ns;
+		break;
+	case RespawnPolicy::Poisson:
+		// every arrival up to now takes a different child, arrivals are allowed to bunch up
+		{
+			std::vector<int> left = slots;
+			while (_next_ns <= now_ns && !left.empty())
+			{
+				size_t pick = std::uniform_int_distribution<size_t>(0, left.size() - 1)(_random);
+				victims.push_back(left[pick]);
+				left.erase(left.begin() + pick);
+				_next_ns += Interval();
+			}
+			if (_next_ns <= now_ns) _next_ns = now_ns + Interval();
+			std::sort(victims.begin(), victims.end());
+		}
+		break;
+	default:
+		victims = slots;
+		_next_ns = now_ns + Interval();
+		break;
+	}
+	_kills += victims.size();
+	return victims;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "settings.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+// ------------------------------
+// respawn scheduler (--respawn-policy): decides when the master kills which children,
+// the supervisor refills the freed slots right after. burst kills every child once a
+// period (the thundering herd the churn always was), rolling kills one child every
+// period / count in slot order so every child lives about one period, and poisson kills
+// a random child at exponentially distributed intervals of the same mean. the random
+// parts come from one generator seeded with kRespawn_seed, the same seed and the same
+// children give the same schedule.
+
+class RespawnScheduler
+{
+public:
+	// period_s is kRespawn_time_in_seconds, count the children the master keeps up
+	RespawnScheduler(RespawnPolicy policy, int period_s, int count, unsigned long long seed);
+
+	// MonotonicNs() of the next kill
+	int64_t				NextKillNs() const { return _next_ns; }
+
+	// the children of slots (ascending, the ones up now) to kill at now_ns, empty
+	// before NextKillNs. schedules the kill after them
+	std::vector<int>	Due(int64_t now_ns, const std::vector<int>& slots);
+
+	RespawnPolicy		Policy() const { return _policy; }
+	unsigned long long	Seed() const { return _seed; }
+	size_t				Kills() const { return _kills; }
+
+private:
+	int64_t				Interval();
+
+	RespawnPolicy		_policy;
+	int64_t				_period_ns;
+	int64_t				_mean_ns;		// between two kills, rolling and poisson
+	unsigned long long	_seed;
+	std::mt19937_64		_random;
+	int64_t				_next_ns;
+	int					_last_slot = -1;	// rolling
+	size_t				_kills = 0;
+};
@@ -0,0 +1,1249 @@
+/*
+* the gl scene shared by every platform: textures, shaders and the spinning cube.
+* everything here runs against whatever context is current.
+* */
+#include "stdafx.h"
+#include "glad.h"
+#include "logging.h"
+#include "settings.h"
+#include "scene.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "obj_reader.h"
+#include "shader_cache.h"
+#include "shared_metrics.h"
+#include "shared_textures.h"
+#include "texture_fill.h"
+#include "texture_upload.h"
+#include "thread_pool.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+// ------------------------------
+// Object
+
+
+const char* cube = R"OBJ(# Blender3D v249 OBJ File: untitled.blend
+# www.blender3d.org
+mtllib cube.mtl
+v 1.000000 -1.000000 -1.000000
+v 1.000000 -1.000000 1.000000
+v -1.000000 -1.000000 1.000000
+v -1.000000 -1.000000 -1.000000
+v 1.000000 1.000000 -1.000000
+v 0.999999 1.000000 1.000001
+v -1.000000 1.000000 1.000000
+v -1.000000 1.000000 -1.000000
+vt 0.748573 0.750412
+vt 0.749279 0.501284
+vt 0.999110 0.501077
+vt 0.999455 0.750380
+vt 0.250471 0.500702
+vt 0.249682 0.749677
+vt 0.001085 0.750380
+vt 0.001517 0.499994
+vt 0.499422 0.500239
+vt 0.500149 0.750166
+vt 0.748355 0.998230
+vt 0.500193 0.998728
+vt 0.498993 0.250415
+vt 0.748953 0.250920
+vn 0.000000 0.000000 -1.000000
+vn -1.000000 -0.000000 -0.000000
+vn -0.000000 -0.000000 1.000000
+vn -0.000001 0.000000 1.000000
+vn 1.000000 -0.000000 0.000000
+vn 1.000000 0.000000 0.000001
+vn 0.000000 1.000000 -0.000000
+vn -0.000000 -1.000000 0.000000
+usemtl Material_ray.png
+s off
+f 5/1/1 1/2/1 4/3/1
+f 5/1/1 4/3/1 8/4/1
+f 3/5/2 7/6/2 8/7/2
+f 3/5/2 8/7/2 4/8/2
+f 2/9/3 6/10/3 3/5/3
+f 6/10/4 7/6/4 3/5/4
+f 1/2/5 5/1/5 2/9/5
+f 5/1/6 6/10/6 2/9/6
+f 5/1/7 8/11/7 6/10/7
+f 8/11/7 7/12/7 6/10/7
+f 1/2/8 2/9/8 3/13/8
+f 1/2/8 3/13/8 4/14/8)OBJ";
+
+
+#define EOS_MATCHER_CHAR	'\0'
+
+static int n_isspace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int nscanf(char*& rp, const char* fmt, ...)
+{
+	int cSuccess = 0;
+	
+	const char* fp = fmt;
+	va_list ap;
+	char* ep;
+	char fc;
+	long v;
+	
+	if (*rp == 0) return EOF;
+
+	va_start(ap, fmt);
+
+	while (*rp && *fp) {
+		fc = *fp;
+		if (*rp == 0)
+			return EOF;
+		if (n_isspace(fc)) {
+			/* do nothing */
+		}
+		else if (fc != '%') {
+			while (n_isspace(*rp)) rp++;
+			if (*rp == 0)
+				break;
+			else if (fc != *rp)
+				break;
+			else
+				rp++;
+		}
+		else {  /* fc == '%' */
+			fc = *++fp;
+			if (fc == 'd' || fc == 'x') {
+				int* ip = va_arg(ap, int*);
+				v = strtol(rp, &ep, fc == 'd' ? 10 : 16);
+				if (rp == ep) break;
+				rp = ep;
+				*ip = v;
+				cSuccess++;
+			}
+			else if (fc == 'f' || fc == 'g' || fc == 'e') {
+				double fv = strtod(rp, &ep);
+				if (ep == rp)
+					break;
+				float* vp = va_arg(ap, float*);
+				*vp = (float)fv;
+				cSuccess++;
+				rp = ep;
+			}
+			else if (fc == 's') {
+				char* vp = va_arg(ap, char*);
+				for(;;)
+				{
+					if(n_isspace(*rp))
+						break;
+					*vp++ = *rp++;
+
+				}
+				*vp = 0;
+				cSuccess++;
+				
+			}
+		}
+		fp++;
+	}
+	
+	while (n_isspace(*rp)) rp++;
+
+	va_end(ap);
+	return cSuccess;
+}
+
+std::shared_ptr<object> loadobj(const char* strObj)
+{
+	char* obj = const_cast<char*>(strObj);
+	std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
+	std::vector< glm::vec3 > temp_vertices;
+	std::vector< glm::vec2 > temp_uvs;
+	std::vector< glm::vec3 > temp_normals;
+
+	object* out = new object();
+	while (1) {
+
+		char lineHeader[128] = { 0 };
+		// read the first word of the line
+		int res = nscanf(obj, "%s", lineHeader);
+		if (res == EOF)
+			break; // EOF = End Of File. Quit the loop.
+		
+		// else : parse lineHeader
+		if (strcmp(lineHeader, "v") == 0) {
+			glm::vec3 vertex;
+			nscanf(obj, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+			temp_vertices.push_back(vertex);
+
+		}
+		else if (strcmp(lineHeader, "vt") == 0) {
+			glm::vec2 uv;
+			nscanf(obj, "%f %f\n", &uv.x, &uv.y);
+			temp_uvs.push_back(uv);
+		}
+		else if (strcmp(lineHeader, "vn") == 0) {
+			glm::vec3 normal;
+			nscanf(obj, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			temp_normals.push_back(normal);
+		}
+		else if (strcmp(lineHeader, "f") == 0) {
+			std::string vertex1, vertex2, vertex3;
+			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+			int matches = nscanf(obj, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+			if (matches != 9) {
+				printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+				return std::shared_ptr<object>();
+			}
+			vertexIndices.push_back(vertexIndex[0]);
+			vertexIndices.push_back(vertexIndex[1]);
+			vertexIndices.push_back(vertexIndex[2]);
+			uvIndices.push_back(uvIndex[0]);
+			uvIndices.push_back(uvIndex[1]);
+			uvIndices.push_back(uvIndex[2]);
+			normalIndices.push_back(normalIndex[0]);
+			normalIndices.push_back(normalIndex[1]);
+			normalIndices.push_back(normalIndex[2]);
+		}
+	}
+	// For each vertex of each triangle
+	for (unsigned int i = 0; i < vertexIndices.size(); i++) 
+	{
+			unsigned int vertexIndex = vertexIndices[i];
+			glm::vec3 vertex = temp_vertices[vertexIndex - 1];
+			out->vertices.push_back(vertex);
+	}
+
+	for (unsigned int i = 0; i < uvIndices.size(); i++) 
+	{
+		unsigned int uvIndex = uvIndices[i];
+		glm::vec2 uvs = temp_uvs[uvIndex - 1];
+		out->uvs.push_back(uvs);
+	}
+
+	for (unsigned int i = 0; i < normalIndices.size(); i++) 
+	{
+		unsigned int normalIndex = normalIndices[i];
+		glm::vec3 normal = temp_normals[normalIndex - 1];
+		out->normals.push_back(normal);
+	}
+	return std::shared_ptr<object>(out);
+}
+
+// ------------------------------
+// Shaders, LoadShaders puts the #version line and the frame uniforms in front
+
+// --ubo: the per-frame values come in one std140 block, matching FrameUniforms
+const char* frameBlock = R"SHADER(
+#define FRAME_UBO
+layout(std140) uniform Frame
+{
+	mat4 VP;
+	mat4 V;
+	vec3 LightPosition_worldspace;
+	int Instanced;
+};
+)SHADER";
+
+struct FrameUniforms
+{
+	glm::mat4	VP;
+	glm::mat4	V;
+	glm::vec3	LightPosition_worldspace;
+	int32_t		Instanced;		// packs into the last 4 bytes of the vec3's slot, as in std140
+};
+static_assert(sizeof(FrameUniforms) == 144, "FrameUniforms must match the std140 layout of Frame");
+
+const char* tshader = R"SHADER(
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace;
+
+// Ouput data
+out vec3 color;
+
+// Values that stay constant for the whole mesh.
+#if defined(TEXTURE_ARRAY)
+uniform sampler2DArray myTextureArray;
+uniform int TextureLayer;
+#elif defined(BINDLESS_TEXTURES)
+layout(bindless_sampler) uniform sampler2D myTextureSampler;
+#else
+uniform sampler2D myTextureSampler;
+#endif
+uniform mat4 MV;
+#ifndef FRAME_UBO
+uniform vec3 LightPosition_worldspace;
+#endif
+
+void main(){
+
+	// Light emission properties
+	// You probably want to put them as uniforms
+	vec3 LightColor = vec3(1,1,1);
+	float LightPower = 50.0f;
+	
+	// Material properties
+#ifdef TEXTURE_ARRAY
+	vec3 MaterialDiffuseColor = texture( myTextureArray, vec3(UV, TextureLayer) ).rgb;
+#else
+	vec3 MaterialDiffuseColor = texture( myTextureSampler, UV ).rgb;
+#endif
+	vec3 MaterialAmbientColor = vec3(0.1,0.1,0.1) * MaterialDiffuseColor;
+	vec3 MaterialSpecularColor = vec3(0.3,0.3,0.3);
+
+	// Distance to the light
+	float distance = length( LightPosition_worldspace - Position_worldspace );
+
+	// Normal of the computed fragment, in camera space
+	vec3 n = normalize( Normal_cameraspace );
+	// Direction of the light (from the fragment to the light)
+	vec3 l = normalize( LightDirection_cameraspace );
+	// Cosine of the angle between the normal and the light direction, 
+	// clamped above 0
+	//  - light is at the vertical of the triangle -> 1
+	//  - light is perpendicular to the triangle -> 0
+	//  - light is behind the triangle -> 0
+	float cosTheta = clamp( dot( n,l ), 0,1 );
+	
+	// Eye vector (towards the camera)
+	vec3 E = normalize(EyeDirection_cameraspace);
+	// Direction in which the triangle reflects the light
+	vec3 R = reflect(-l,n);
+	// Cosine of the angle between the Eye vector and the Reflect vector,
+	// clamped to 0
+	//  - Looking into the reflection -> 1
+	//  - Looking elsewhere -> < 1
+	float cosAlpha = clamp( dot( E,R ), 0,1 );
+	
+	color = 
+		// Ambient : simulates indirect lighting
+		MaterialAmbientColor +
+		// Diffuse : "color" of the object
+		MaterialDiffuseColor * LightColor * LightPower * cosTheta / (distance*distance) +
+		// Specular : reflective highlight, like a mirror
+		MaterialSpecularColor * LightColor * LightPower * pow(cosAlpha,5) / (distance*distance);
+	}
+)SHADER";
+
+
+const char* vshader = R"SHADER(
+
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+// Model matrix of the instance, --instanced only (a mat4 takes locations 3 to 6)
+layout(location = 3) in mat4 InstanceModel;
+// Output data ; will be interpolated for each fragment.
+out vec2 UV;
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+out vec3 LightDirection_cameraspace;
+
+// Values that stay constant for the whole mesh.
+uniform mat4 M;
+#ifndef FRAME_UBO
+uniform mat4 VP;
+uniform mat4 V;
+uniform int Instanced;
+uniform vec3 LightPosition_worldspace;
+#endif
+
+void main(){
+
+	mat4 Model = Instanced != 0 ? InstanceModel : M;
+
+	// Output position of the vertex, in clip space : VP * Model * position
+	gl_Position =  VP * Model * vec4(vertexPosition_modelspace,1);
+	
+	// Position of the vertex, in worldspace : M * position
+	Position_worldspace = (Model * vec4(vertexPosition_modelspace,1)).xyz;
+	
+	// Vector that goes from the vertex to the camera, in camera space.
+	// In camera space, the camera is at the origin (0,0,0).
+	vec3 vertexPosition_cameraspace = ( V * Model * vec4(vertexPosition_modelspace,1)).xyz;
+	EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
+
+	// Vector that goes from the vertex to the light, in camera space. M is ommited because it's identity.
+	vec3 LightPosition_cameraspace = ( V * vec4(LightPosition_worldspace,1)).xyz;
+	LightDirection_cameraspace = LightPosition_cameraspace + EyeDirection_cameraspace;
+	
+	// Normal of the the vertex, in camera space
+	Normal_cameraspace = ( V * Model * vec4(vertexNormal_modelspace,0)).xyz; // Only correct if ModelMatrix does not scale the model ! Use its inverse transpose if not.
+	
+	// UV of the vertex. No special space for this one.
+	UV = vertexUV;
+}
+)SHADER";
+
+// kTexture_mode, or what InitScene fell back to when the context can't do it. per thread
+// like the rest of the scene
+thread_local TextureMode g_textureMode = TextureMode::Single;
+
+// ------------------------------
+// gl stuff
+
+GLuint LoadShaders() {
+
+	int64_t start = MonotonicNs();
+	int64_t saved_ns = 0;
+	// the #version line has to come first, then the texture mode (#extension has to
+	// precede any code) and the frame block (if any)
+	const char* version = "#version 330 core\n";
+	const char* textures = g_textureMode == TextureMode::Array ? "#define TEXTURE_ARRAY\n"
+		: g_textureMode == TextureMode::Bindless ? "#extension GL_ARB_bindless_texture : require\n#define BINDLESS_TEXTURES\n" : "";
+	const char* frame = kUbo ? frameBlock : "";
+	const char* vsources[] = { version, textures, frame, vshader };
+	const char* tsources[] = { version, textures, frame, tshader };
+
+	uint64_t cache_key = ProgramCacheKey({ version, textures, frame, vshader, tshader });
+	GLuint CachedProgramID = LoadCachedProgram(cache_key, saved_ns);
+	if (CachedProgramID != 0)
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "program loaded from the cache in " << NsToMs(MonotonicNs() - start) << " ms, "
+			<< NsToMs(saved_ns) << " ms of compiling saved";
+		return CachedProgramID;
+	}
+
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	
+	glShaderSource(VertexShaderID, 4, vsources, NULL);
+	glCompileShader(VertexShaderID);
+
+	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 0) {
+		std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
+		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+		LOG(ERROR) << "[" << _instance_name << "] " << &VertexShaderErrorMessage[0];
+	}
+
+	glShaderSource(FragmentShaderID, 4, tsources, NULL);
+	glCompileShader(FragmentShaderID);
+
+
+	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 0) {
+		std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
+		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+		LOG(ERROR) << "[" << _instance_name << "] " << &FragmentShaderErrorMessage[0];
+	}
+
+	// Link 
+
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	glAttachShader(ProgramID, FragmentShaderID);
+	PrepareCachedProgram(ProgramID);
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 0) {
+		std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		LOG(ERROR) << "[" << _instance_name << "] " << &ProgramErrorMessage[0];
+	}
+
+	glDetachShader(ProgramID, VertexShaderID);
+	glDetachShader(ProgramID, FragmentShaderID);
+
+	glDeleteShader(VertexShaderID);
+	glDeleteShader(FragmentShaderID);
+
+	int64_t compile_ns = MonotonicNs() - start;
+	LOG(INFO) << "[" << _instance_name << "] " << "program compiled in " << NsToMs(compile_ns) << " ms";
+	if (Result == GL_TRUE)
+	{
+		StoreCachedProgram(cache_key, ProgramID, compile_ns);
+	}
+
+	return ProgramID;
+}
+
+// ------------------------------
+// cube generated from blender
+
+static const GLfloat g_vertex_buffer_data[] = {
+	-1.0f,-1.0f,-1.0f, // triangle 1 : begin
+	-1.0f,-1.0f, 1.0f,
+	-1.0f, 1.0f, 1.0f, // triangle 1 : end
+	1.0f, 1.0f,-1.0f, // triangle 2 : begin
+	-1.0f,-1.0f,-1.0f,
+	-1.0f, 1.0f,-1.0f, // triangle 2 : end
+	1.0f,-1.0f, 1.0f,
+	-1.0f,-1.0f,-1.0f,
+	1.0f,-1.0f,-1.0f,
+	1.0f, 1.0f,-1.0f,
+	1.0f,-1.0f,-1.0f,
+	-1.0f,-1.0f,-1.0f,
+	-1.0f,-1.0f,-1.0f,
+	-1.0f, 1.0f, 1.0f,
+	-1.0f, 1.0f,-1.0f,
+	1.0f,-1.0f, 1.0f,
+	-1.0f,-1.0f, 1.0f,
+	-1.0f,-1.0f,-1.0f,
+	-1.0f, 1.0f, 1.0f,
+	-1.0f,-1.0f, 1.0f,
+	1.0f,-1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f,-1.0f,-1.0f,
+	1.0f, 1.0f,-1.0f,
+	1.0f,-1.0f,-1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f,-1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f,-1.0f,
+	-1.0f, 1.0f,-1.0f,
+	1.0f, 1.0f, 1.0f,
+	-1.0f, 1.0f,-1.0f,
+	-1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	-1.0f, 1.0f, 1.0f,
+	1.0f,-1.0f, 1.0f
+};
+static const GLfloat g_color_buffer_data[] = {
+	0.583f,  0.771f,  0.014f,
+	0.609f,  0.115f,  0.436f,
+	0.327f,  0.483f,  0.844f,
+	0.822f,  0.569f,  0.201f,
+	0.435f,  0.602f,  0.223f,
+	0.310f,  0.747f,  0.185f,
+	0.597f,  0.770f,  0.761f,
+	0.559f,  0.436f,  0.730f,
+	0.359f,  0.583f,  0.152f,
+	0.483f,  0.596f,  0.789f,
+	0.559f,  0.861f,  0.639f,
+	0.195f,  0.548f,  0.859f,
+	0.014f,  0.184f,  0.576f,
+	0.771f,  0.328f,  0.970f,
+	0.406f,  0.615f,  0.116f,
+	0.676f,  0.977f,  0.133f,
+	0.971f,  0.572f,  0.833f,
+	0.140f,  0.616f,  0.489f,
+	0.997f,  0.513f,  0.064f,
+	0.945f,  0.719f,  0.592f,
+	0.543f,  0.021f,  0.978f,
+	0.279f,  0.317f,  0.505f,
+	0.167f,  0.620f,  0.077f,
+	0.347f,  0.857f,  0.137f,
+	0.055f,  0.953f,  0.042f,
+	0.714f,  0.505f,  0.345f,
+	0.783f,  0.290f,  0.734f,
+	0.722f,  0.645f,  0.174f,
+	0.302f,  0.455f,  0.848f,
+	0.225f,  0.587f,  0.040f,
+	0.517f,  0.713f,  0.338f,
+	0.053f,  0.959f,  0.120f,
+	0.393f,  0.621f,  0.362f,
+	0.673f,  0.211f,  0.457f,
+	0.820f,  0.883f,  0.371f,
+	0.982f,  0.099f,  0.879f
+};
+static const GLfloat g_uv_buffer_data[] = {
+	0.000059f, 1.0f - 0.000004f,
+	0.000103f, 1.0f - 0.336048f,
+	0.335973f, 1.0f - 0.335903f,
+	1.000023f, 1.0f - 0.000013f,
+	0.667979f, 1.0f - 0.335851f,
+	0.999958f, 1.0f - 0.336064f,
+	0.667979f, 1.0f - 0.335851f,
+	0.336024f, 1.0f - 0.671877f,
+	0.667969f, 1.0f - 0.671889f,
+	1.000023f, 1.0f - 0.000013f,
+	0.668104f, 1.0f - 0.000013f,
+	0.667979f, 1.0f - 0.335851f,
+	0.000059f, 1.0f - 0.000004f,
+	0.335973f, 1.0f - 0.335903f,
+	0.336098f, 1.0f - 0.000071f,
+	0.667979f, 1.0f - 0.335851f,
+	0.335973f, 1.0f - 0.335903f,
+	0.336024f, 1.0f - 0.671877f,
+	1.000004f, 1.0f - 0.671847f,
+	0.999958f, 1.0f - 0.336064f,
+	0.667979f, 1.0f - 0.335851f,
+	0.668104f, 1.0f - 0.000013f,
+	0.335973f, 1.0f - 0.335903f,
+	0.667979f, 1.0f - 0.335851f,
+	0.335973f, 1.0f - 0.335903f,
+	0.668104f, 1.0f - 0.000013f,
+	0.336098f, 1.0f - 0.000071f,
+	0.000103f, 1.0f - 0.336048f,
+	0.000004f, 1.0f - 0.671870f,
+	0.336024f, 1.0f - 0.671877f,
+	0.000103f, 1.0f - 0.336048f,
+	0.336024f, 1.0f - 0.671877f,
+	0.335973f, 1.0f - 0.335903f,
+	0.667969f, 1.0f - 0.671889f,
+	1.000004f, 1.0f - 0.671847f,
+	0.667979f, 1.0f - 0.335851f
+};
+// the mesh is either parsed here or mapped from the cache, g_meshView points into whichever.
+// all of the scene is per thread, every render thread (--threads) has a scene of its own
+thread_local std::unique_ptr<IndexedMesh> g_mesh;
+thread_local MappedMesh g_mappedMesh;
+thread_local MeshView g_meshView;
+
+// ------------------------------
+// helper stuff
+
+void* memset32(void* m, uint32_t val, size_t count)
+{
+	count /= 4;
+	uint32_t* buf = static_cast<uint32_t*>(m);
+	while (count--) *buf++ = val;
+	return m;
+}
+
+// ------------------------------
+// opengl scene variables
+
+thread_local GLuint _programID;
+thread_local GLuint g_vertexbuffer;			// interleaved MeshVertex
+thread_local GLuint g_indexbuffer;
+thread_local GLuint g_instancebuffer;		// model matrix per object, --instanced
+thread_local GLuint g_vertexarray;
+thread_local GLuint g_frameBuffer;			// FrameUniforms, --ubo
+thread_local FrameUniforms g_frameUniforms;
+thread_local GLint g_modelMatrixID = -1;
+thread_local std::vector<glm::mat4> g_instanceModels;
+thread_local SceneStats g_stats;
+thread_local GLuint g_textures[kMaxNum_Textures];
+thread_local GLuint g_textureArray;			// --texture-mode array, layer t holds texture t
+thread_local GLuint64 g_textureHandles[kMaxNum_Textures];	// --texture-mode bindless
+thread_local GLint g_textureSelectID = -1;	// the layer or handle uniform
+thread_local uint32_t g_textureColors[kMaxNum_Textures];
+thread_local int g_texturesResident = 0;		// textures [0, g_texturesResident) hold their texels
+
+thread_local int g_currentTexture = 0;
+
+// texture uploads
+static const int kPboRingSlots = 3;
+static thread_local PboUploadRing g_uploadRing;
+static thread_local std::unique_ptr<ThreadPool> g_fillPool;
+static thread_local int64_t g_texturesStart = 0;
+static thread_local int64_t g_fillNs = 0;
+
+void makechecker(unsigned int* pixels, size_t wh)
+{
+
+	auto pitch = wh;
+	auto data_size = wh * pitch;
+	const size_t check_size = wh/32;
+
+	for (auto it = pixels; it < pixels + data_size; ) {
+		
+		size_t y = (it - pixels) / pitch;
+		size_t x = (it - pixels - y * pitch);
+
+		memset(it, 0x88, check_size*4);
+		it += check_size;
+
+		if (((y+1) % check_size == 0) && (x == wh-check_size))
+		{
+			it += check_size * 2;
+		}
+		else if (((y+1) % check_size == 0) && (x == wh - check_size*2))
+		{
+			it += check_size*4;
+		}
+		else
+			it += check_size;
+
+		
+
+		
+		int z = 0;
+		z++;
+	}
+	
+}
+
+// ------------------------------
+// texture residency: what a texture is and how a frame selects it, per --texture-mode
+
+// free video memory in kb as the driver reports it, -1 without NVX_gpu_memory_info or ATI_meminfo
+static GLint FreeVideoMemoryKb()
+{
+	GLint kb[4] = { -1, -1, -1, -1 };
+	if (GLAD_GL_NVX_gpu_memory_info) glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, kb);
+	else if (GLAD_GL_ATI_meminfo) glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kb);
+	return kb[0];
+}
+
+static void GenTextures()
+{
+	if (g_textureMode != TextureMode::Array)
+	{
+		glGenTextures(kNum_Textures, g_textures);
+		return;
+	}
+
+	// one allocation for every layer, the texels follow per layer
+	glGenTextures(1, &g_textureArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, g_textureArray);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, (GLsizei)kTexture_width, (GLsizei)kTexture_width, kNum_Textures, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+// storage of texture t, with its texels when pixels isn't null
+static void SpecifyTexture(int t, const void* pixels)
+{
+	TraceScope trace(pixels ? "texture upload" : "texture storage", t);
+	if (pixels) RecordUpload(kTexture_size);
+	if (g_textureMode == TextureMode::Array)
+	{
+		if (pixels == nullptr) return;
+		glBindTexture(GL_TEXTURE_2D_ARRAY, g_textureArray);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, t, (GLsizei)kTexture_width, (GLsizei)kTexture_width, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, g_textures[t]);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)kTexture_width, (GLsizei)kTexture_width, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+// once every texture has its storage: the array stays bound to unit 0 for good,
+// bindless handles are made resident (which freezes the texture's parameters)
+static void MakeTexturesResident()
+{
+	glUseProgram(_programID);
+	if (g_textureMode == TextureMode::Array)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, g_textureArray);
+		glUniform1i(glGetUniformLocation(_programID, "myTextureArray"), 0);
+		g_textureSelectID = glGetUniformLocation(_programID, "TextureLayer");
+	}
+	else if (g_textureMode == TextureMode::Bindless)
+	{
+		for (auto t = 0; t < kNum_Textures; ++t)
+		{
+			g_textureHandles[t] = glGetTextureHandleARB(g_textures[t]);
+			glMakeTextureHandleResidentARB(g_textureHandles[t]);
+		}
+		g_textureSelectID = glGetUniformLocation(_programID, "myTextureSampler");
+	}
+}
+
+// the texture of this frame, the program has to be current
+static void SelectTexture(int t)
+{
+	int64_t start = MonotonicNs();
+	switch (g_textureMode)
+	{
+	case TextureMode::Array:	glUniform1i(g_textureSelectID, t); break;
+	case TextureMode::Bindless:	glUniformHandleui64ARB(g_textureSelectID, g_textureHandles[t]); break;
+	default:					glBindTexture(GL_TEXTURE_2D, g_textures[t]); break;
+	}
+	g_stats.select_ns += MonotonicNs() - start;
+}
+
+// ------------------------------
+// texture uploads
+
+// the texels of texture t into dst, copied from the master's segment or filled here
+static void FillTexture(int t, void* dst)
+{
+	TraceScope trace("texture fill", t);
+	int64_t start = MonotonicNs();
+	const void* shared = SharedTexture(t);
+	if (shared)
+	{
+		memcpy(dst, shared, kTexture_size);
+	}
+	else
+	{
+		FillChecker((uint32_t*)dst, kTexture_width, g_textureColors[t], g_fillPool.get());
+	}
+	g_fillNs += MonotonicNs() - start;
+}
+
+// pbo mode: push up to budget more textures through the ring, filling the next slot
+// overlaps with the driver copying out of the previous one
+static void UploadPendingTextures(int budget)
+{
+	if (!g_uploadRing.Valid()) return;
+
+	for (; budget > 0 && g_texturesResident < kNum_Textures; --budget)
+	{
+		void* dst = g_uploadRing.Begin();
+		if (dst == nullptr)
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "pbo ring: map failed, " << kNum_Textures - g_texturesResident << " textures left empty";
+			g_uploadRing.Destroy();
+			return;
+		}
+		FillTexture(g_texturesResident, dst);
+		TraceScope trace("texture upload", g_texturesResident);
+		if (g_textureMode == TextureMode::Array) g_uploadRing.End(g_textureArray, (GLsizei)kTexture_width, g_texturesResident);
+		else g_uploadRing.End(g_textures[g_texturesResident], (GLsizei)kTexture_width);
+		RecordUpload(kTexture_size);
+		g_texturesResident++;
+	}
+
+	if (g_texturesResident == kNum_Textures)
+	{
+		RecordPhase(MetricsPhase::Textures, MonotonicNs() - g_texturesStart);
+		TraceEvent("textures", g_texturesStart, MonotonicNs());
+		LOG(INFO) << "[" << _instance_name << "] " << "pbo upload: " << kNum_Textures << " textures resident after " << NsToMs(MonotonicNs() - g_texturesStart)
+			<< " ms (" << (g_uploadRing.Persistent() ? "persistent" : "mapped") << " ring, fill " << NsToMs(g_fillNs) << " ms)";
+		g_uploadRing.Destroy();
+		g_fillPool.reset();
+	}
+}
+
+// ------------------------------
+// objects: a square grid around the origin, 3 units apart, spinning out of phase.
+// a single object sits at the origin and spins like the original cube
+
+static int ObjectGridSide()
+{
+	return (int)std::ceil(std::sqrt((float)kObject_count));
+}
+
+static float ObjectGridScale()
+{
+	return std::max(1.0f, ObjectGridSide() * 0.75f);
+}
+
+static glm::mat4 ObjectModel(int i, float time)
+{
+	int side = ObjectGridSide();
+	float center = (side - 1) * 0.5f;
+	glm::vec3 position((i % side - center) * 3.0f, 0.0f, (i / side - center) * 3.0f);
+	glm::mat4 Model = glm::translate(glm::mat4(1), position);
+	return glm::rotate(Model, time * 0.02f + i * 0.7f, glm::vec3(0.5f, 1.00f, 0.50f));
+}
+
+// ------------------------------
+// --ubo: everything the original path sets up every frame, done once. the attributes
+// go into the vao, the matrices are computed here and the frame block is bound to 0
+
+static void InitFrameState()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, g_vertexbuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, uv));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+	if (kInstanced)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, g_instancebuffer);
+		for (int c = 0; c < 4; ++c)
+		{
+			glEnableVertexAttribArray(3 + c);
+			glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(c * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + c, 1);
+		}
+	}
+
+	float scale = ObjectGridScale();
+	glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float)200 / (float)200, 0.1f, 100.0f * scale);
+	glm::mat4 View = glm::lookAt(glm::vec3(4, 3, 3) * scale, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	g_frameUniforms.VP = Projection * View;
+	g_frameUniforms.V = View;
+	g_frameUniforms.LightPosition_worldspace = glm::vec3(4, 4, 4) * scale;
+	g_frameUniforms.Instanced = kInstanced ? 1 : 0;
+
+	glGenBuffers(1, &g_frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, g_frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &g_frameUniforms, GL_DYNAMIC_DRAW);
+	glUniformBlockBinding(_programID, glGetUniformBlockIndex(_programID, "Frame"), 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, g_frameBuffer);
+
+	glUseProgram(_programID);
+	if (g_textureMode == TextureMode::Single) glUniform1i(glGetUniformLocation(_programID, "myTextureSampler"), 0);
+	g_modelMatrixID = glGetUniformLocation(_programID, "M");
+}
+
+// ------------------------------
+// opengl resource allocation (buffers and shaders)
+
+// --mesh, or the built-in cube when there is none (or it can't be read),
+// deduplicated and reordered for the vertex cache
+static void LoadMesh()
+{
+	int64_t start = MonotonicNs();
+	std::string name = kMesh_file;
+	if (!name.empty() && g_mappedMesh.Open(name.c_str()))
+	{
+		g_meshView = g_mappedMesh.View();
+		LOG(INFO) << "[" << _instance_name << "] " << "mesh " << name << ": " << g_meshView.index_count / 3 << " triangles, " << g_meshView.vertex_count
+			<< " vertices, mapped from the cache in " << NsToMs(MonotonicNs() - start) << " ms";
+		return;
+	}
+
+	ObjMesh obj;
+	bool loaded = false;
+	if (!name.empty())
+	{
+		// production meshes are hundreds of mb of text, parse them on all cores
+		ThreadPool pool;
+		loaded = ReadObjFile(name.c_str(), obj, &pool) && obj.Triangles() > 0;
+	}
+	if (!loaded)
+	{
+		if (!name.empty()) LOG(ERROR) << "[" << _instance_name << "] " << "can't load mesh " << name << ", drawing the cube";
+		name.clear();
+		ReadObj(cube, cube + strlen(cube), obj);
+	}
+	int64_t read_ns = MonotonicNs() - start;
+
+	g_mesh = std::make_unique<IndexedMesh>();
+	BuildIndexedMesh(obj, *g_mesh);
+	float acmr = VertexCacheMissRatio(*g_mesh);
+	OptimizeVertexCache(*g_mesh);
+	g_meshView = g_mesh->View();
+	LOG(INFO) << "[" << _instance_name << "] " << "mesh " << (name.empty() ? "cube" : name) << ": " << g_mesh->Triangles() << " triangles, " << g_mesh->vertices.size()
+		<< " vertices (" << obj.corners.size() << " corners), read in " << NsToMs(read_ns) << " ms, indexed in " << NsToMs(MonotonicNs() - start - read_ns)
+		<< " ms, acmr " << acmr << " -> " << VertexCacheMissRatio(*g_mesh);
+
+	// the cube is parsed in microseconds, only files are worth caching
+	if (!name.empty()) StoreMeshCache(name.c_str(), *g_mesh);
+}
+
+void PrepareScene()
+{
+	if (g_meshView.index_count == 0) LoadMesh();
+	if (kShared_textures) MapSharedTextures();
+}
+
+bool InitScene()
+{
+	g_textureMode = kTexture_mode;
+	if (g_textureMode == TextureMode::Bindless && !GLAD_GL_ARB_bindless_texture)
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "no ARB_bindless_texture, binding 2d textures instead";
+		g_textureMode = TextureMode::Single;
+	}
+	int64_t phase_start = MonotonicNs();
+	_programID = LoadShaders();
+	RecordPhase(MetricsPhase::Shaders, MonotonicNs() - phase_start);
+	TraceEvent("LoadShaders", phase_start, MonotonicNs());
+	
+
+	glShadeModel(GL_SMOOTH);						
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);				
+	glClearDepth(1.0f);									
+	glDisable(GL_DEPTH_TEST);							
+	glDepthFunc(GL_LEQUAL);								
+	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+    glEnable(GL_NORMALIZE);
+
+	phase_start = MonotonicNs();
+	PrepareScene();
+	RecordPhase(MetricsPhase::Mesh, MonotonicNs() - phase_start);
+	TraceEvent("mesh", phase_start, MonotonicNs());
+
+	GLint free_kb = FreeVideoMemoryKb();
+	GenTextures();
+	//::ZeroMemory(large_texture, kTexture_size);
+	std::mt19937 gen;
+	gen.seed(static_cast<uint32_t>(time(nullptr)));
+	for (auto t = 0; t < kNum_Textures; ++t)
+	{
+		unsigned val = (unsigned int)(gen()) | 0x000000ff;
+		unsigned val2 = (unsigned int)(gen()) | 0x000000ff;
+		g_textureColors[t] = val;
+	}
+	g_fillPool = std::make_unique<ThreadPool>();
+	g_texturesStart = MonotonicNs();
+
+	if (kPbo_upload && g_uploadRing.Init(kTexture_size, kPboRingSlots))
+	{
+		// storage only, the texels follow through the ring: the first one right away,
+		// the rest one per frame from DrawScene
+		for (auto t = 0; t < kNum_Textures; ++t)
+		{
+			SpecifyTexture(t, nullptr);
+		}
+		MakeTexturesResident();
+		LOG(INFO) << "[" << _instance_name << "] " << "Allocated " << ((kNum_Textures* kTexture_size)/(1024*1024)) << "mb of Textures.";
+		UploadPendingTextures(1);
+	}
+	else
+	{
+		// pixels come straight from the master's shared segment, or get filled here
+		char* large_texture = SharedTexture(0) ? nullptr : new (std::align_val_t(kTextureAlignment)) char[kTexture_size];
+		for (auto t = 0; t < kNum_Textures; ++t)
+		{
+			const void* pixels = SharedTexture(t);
+			if (!pixels)
+			{
+				FillTexture(t, large_texture);
+				pixels = large_texture;
+			}
+			SpecifyTexture(t, pixels);
+
+		} // ignore freeing gl memory (lets see what driver does)
+		MakeTexturesResident();
+		g_texturesResident = kNum_Textures;
+		RecordPhase(MetricsPhase::Textures, MonotonicNs() - g_texturesStart);
+		TraceEvent("textures", g_texturesStart, MonotonicNs());
+		LOG(INFO) << "[" << _instance_name << "] " << "Allocated " << ((kNum_Textures* kTexture_size)/(1024*1024)) << "mb of Textures.";
+		if (large_texture)
+		{
+			LOG(INFO) << "[" << _instance_name << "] " << "texture fill: " << NsToMs(g_fillNs) << " ms (" << FillKernelName(BestFillKernel())
+				<< ", " << g_fillPool->Size() << " threads)";
+			// the process used to take it along when it died, a render thread (--threads) has to give it back
+			operator delete[](large_texture, std::align_val_t(kTextureAlignment));
+		}
+		else
+		{
+			LOG(INFO) << "[" << _instance_name << "] " << "textures uploaded from the master's shared memory";
+		}
+		g_fillPool.reset();
+	}
+
+	// what the driver charged for them, the pbo path has only allocated storage so far
+	GLint taken_kb = free_kb - FreeVideoMemoryKb();
+	LOG(INFO) << "[" << _instance_name << "] " << "texture mode " << TextureModeName(g_textureMode) << ": " << kNum_Textures << " textures";
+	if (free_kb >= 0)
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "video memory taken by textures: " << taken_kb / 1024 << "mb ("
+			<< ((kNum_Textures * kTexture_size) / (1024 * 1024)) << "mb of texels)";
+	}
+
+	glGenVertexArrays(1, &g_vertexarray);
+	glBindVertexArray(g_vertexarray);
+
+
+	// one interleaved buffer for all attributes, the element buffer is part of the vao.
+	// a cached mesh goes from its mapping to the driver without any copy of our own
+	glGenBuffers(1, &g_vertexbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, g_vertexbuffer);
+	glBufferData(GL_ARRAY_BUFFER, g_meshView.vertex_count * sizeof(MeshVertex), g_meshView.vertices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &g_indexbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_indexbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, g_meshView.index_count * sizeof(uint32_t), g_meshView.indices, GL_STATIC_DRAW);
+	RecordUpload(g_meshView.vertex_count * sizeof(MeshVertex) + g_meshView.index_count * sizeof(uint32_t));
+
+	if (kInstanced)
+	{
+		glGenBuffers(1, &g_instancebuffer);
+		g_instanceModels.resize(kObject_count);
+	}
+
+	if (kUbo)
+	{
+		InitFrameState();
+	}
+	LOG(INFO) << "[" << _instance_name << "] " << kObject_count << " objects, " << (kInstanced ? "one instanced draw" : "one draw each")
+		<< (kUbo ? ", uniform buffer path" : "");
+
+	return true;
+}
+
+// ------------------------------
+// main scene render
+
+// every call of the original path: matrices, uniforms and attribute setup each frame
+static void SubmitFrame(float _time)
+{
+	// pull the camera (and the light) back until the whole grid is in view
+	float scale = ObjectGridScale();
+	glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float)200 / (float)200, 0.1f, 100.0f * scale);
+	glm::mat4 View = glm::lookAt(
+		glm::vec3(4, 3, 3) * scale, // camera
+		glm::vec3(0, 0, 0), // origin
+		glm::vec3(0, 1, 0)  // up 
+	);
+
+	glm::mat4 vp = Projection * View;
+
+	static thread_local GLuint MatrixID = glGetUniformLocation(_programID, "VP");
+	static thread_local GLuint LightID = glGetUniformLocation(_programID, "LightPosition_worldspace");
+	static thread_local GLuint ViewMatrixID = glGetUniformLocation(_programID, "V");
+	static thread_local GLuint ModelMatrixID = glGetUniformLocation(_programID, "M");
+	static thread_local GLuint InstancedID = glGetUniformLocation(_programID, "Instanced");
+	static thread_local GLuint TextureID = glGetUniformLocation(_programID, "myTextureSampler");
+	
+	if (g_textureMode == TextureMode::Single) glUniform1i(TextureID, 0);
+
+	glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &View[0][0]);
+	glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &vp[0][0]);
+	glUniform1i(InstancedID, kInstanced ? 1 : 0);
+
+	glm::vec3 lightPos = glm::vec3(4, 4, 4) * scale;
+	glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
+	
+	glEnable(GL_DEPTH_TEST);
+	
+	glDepthFunc(GL_LESS);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUseProgram(_programID);
+	glEnableVertexAttribArray(0);
+
+	SelectTexture(g_currentTexture);
+	glBindBuffer(GL_ARRAY_BUFFER, g_vertexbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_indexbuffer);
+	
+	glVertexAttribPointer(
+		0,                  // vertex
+		3,                  // size
+		GL_FLOAT,           // type
+		GL_FALSE,           // normalized
+		sizeof(MeshVertex), // stride
+		(void*)offsetof(MeshVertex, position)
+	);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(
+		1,                  // uv
+		2,                  // size
+		GL_FLOAT,           // type
+		GL_FALSE,           // normalized
+		sizeof(MeshVertex), // stride
+		(void*)offsetof(MeshVertex, uv)
+	);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(
+		2,                  // normal
+		3,                  // size
+		GL_FLOAT,           // type
+		GL_FALSE,           // normalized
+		sizeof(MeshVertex), // stride
+		(void*)offsetof(MeshVertex, normal)
+	);
+
+	if (kInstanced)
+	{
+		// every model matrix in one upload (orphaning last frame's storage), then one draw
+		for (int i = 0; i < kObject_count; ++i) g_instanceModels[i] = ObjectModel(i, _time);
+		glBindBuffer(GL_ARRAY_BUFFER, g_instancebuffer);
+		glBufferData(GL_ARRAY_BUFFER, kObject_count * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, kObject_count * sizeof(glm::mat4), g_instanceModels.data());
+		for (int c = 0; c < 4; ++c)
+		{
+			glEnableVertexAttribArray(3 + c);
+			glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(c * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + c, 1);
+		}
+
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)g_meshView.index_count, GL_UNSIGNED_INT, (void*)0, kObject_count);
+		g_stats.draws++;
+
+		for (int c = 0; c < 4; ++c) glDisableVertexAttribArray(3 + c);
+	}
+	else
+	{
+		// the worst case: a uniform update and a draw per object
+		for (int i = 0; i < kObject_count; ++i)
+		{
+			glm::mat4 Model = ObjectModel(i, _time);
+			glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &Model[0][0]);
+			glDrawElements(GL_TRIANGLES, (GLsizei)g_meshView.index_count, GL_UNSIGNED_INT, (void*)0);
+		}
+		g_stats.draws += kObject_count;
+	}
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+}
+
+// --ubo: cached matrices, one buffer update and the vao from InitScene
+static void SubmitFrameUbo(float _time)
+{
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUseProgram(_programID);
+	glBindVertexArray(g_vertexarray);
+	SelectTexture(g_currentTexture);
+
+	// constant today, but this is where per-frame state (camera, lights) goes
+	glBindBuffer(GL_UNIFORM_BUFFER, g_frameBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &g_frameUniforms);
+
+	if (kInstanced)
+	{
+		for (int i = 0; i < kObject_count; ++i) g_instanceModels[i] = ObjectModel(i, _time);
+		glBindBuffer(GL_ARRAY_BUFFER, g_instancebuffer);
+		glBufferData(GL_ARRAY_BUFFER, kObject_count * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, kObject_count * sizeof(glm::mat4), g_instanceModels.data());
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)g_meshView.index_count, GL_UNSIGNED_INT, (void*)0, kObject_count);
+		g_stats.draws++;
+	}
+	else
+	{
+		for (int i = 0; i < kObject_count; ++i)
+		{
+			glm::mat4 Model = ObjectModel(i, _time);
+			glUniformMatrix4fv(g_modelMatrixID, 1, GL_FALSE, &Model[0][0]);
+			glDrawElements(GL_TRIANGLES, (GLsizei)g_meshView.index_count, GL_UNSIGNED_INT, (void*)0);
+		}
+		g_stats.draws += kObject_count;
+	}
+}
+
+void DrawScene()
+{
+	// frame time is start to start, presenting and pacing included
+	static thread_local int64_t previous_start = 0;
+	int64_t start = MonotonicNs();
+	if (previous_start != 0) RecordFrame(start - previous_start);
+	previous_start = start;
+	UploadPendingTextures(1);
+
+	// some lame movement
+	static thread_local float _time = 0;
+	static thread_local float one = 0;
+	static thread_local float sine = 0;
+	bool up = false;
+
+	_time +=1.0f;
+	one+= up?0.01f:-0.01f;
+	sine = (float)(sinf(_time /100.0f)+1.0)/2.0f;
+	if(one > 1) {one = 1.0f;up = false;};
+	if(one < 0) {one = 0.0f;up = true;};
+	glClearColor(1-sine,one,sine,1.0f);
+	
+
+	if (kUbo) SubmitFrameUbo(_time);
+	else SubmitFrame(_time);
+
+	g_currentTexture++;
+	g_currentTexture = (++g_currentTexture) % std::max(g_texturesResident, 1);
+
+	g_stats.frames++;
+	g_stats.cpu_ns += MonotonicNs() - start;
+}
+
+TextureMode SceneTextureMode()
+{
+	return g_textureMode;
+}
+
+SceneStats TakeSceneStats()
+{
+	SceneStats stats = g_stats;
+	g_stats = SceneStats();
+	return stats;
+}
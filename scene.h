@@ -0,0 +1,54 @@
+#pragma once
+
+#include "glad.h"
+#include "settings.h"
+
+#include <memory>
+#include <vector>
+#include "glm/glm.hpp"
+
+// ------------------------------
+// Object
+
+class object
+{
+public:
+	object() {}
+	std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
+	std::vector< glm::vec3 > vertices;
+	std::vector< glm::vec2 > uvs;
+	std::vector< glm::vec3 > normals;
+};
+
+extern const char*	cube;
+
+int							nscanf(char*& rp, const char* fmt, ...);
+std::shared_ptr<object>		loadobj(const char* strObj);
+
+// ------------------------------
+// texture helpers, the original scalar fill (InitScene uses FillChecker from texture_fill.h)
+
+void*	memset32(void* m, uint32_t val, size_t count);
+void	makechecker(unsigned int* pixels, size_t wh);
+
+// ------------------------------
+// scene, both expect a current context with the gl entrypoints loaded
+
+// the context independent part of InitScene (parsing the object), safe to run before a fork
+void	PrepareScene();
+// allocate textures, shaders and buffers
+bool	InitScene();
+// render one frame into the bound framebuffer, presenting it is up to the caller
+void	DrawScene();
+
+// what DrawScene did since the last call
+struct SceneStats
+{
+	size_t		frames = 0;
+	size_t		draws = 0;		// draw calls, an instanced draw counts once
+	int64_t		cpu_ns = 0;		// spent in DrawScene, submitting
+	int64_t		select_ns = 0;	// of which selecting the frame's texture (bind, layer or handle)
+};
+SceneStats	TakeSceneStats();
+// the texture mode InitScene ended up with, kTexture_mode unless the context lacks bindless
+TextureMode	SceneTextureMode();
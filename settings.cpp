@@ -0,0 +1,405 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "options.h"
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+
+// ------------------------------
+// Default Configuration options
+int kMax_num_process_count		= 3;
+int kRespawn_time_in_seconds	= 2;
+int kNum_Textures				= 10;
+size_t kTexture_width			= 4096;
+size_t kTexture_size			= kTexture_width * kTexture_width * 4;
+
+bool kZygote					= false;
+bool kShared_textures			= true;
+bool kPbo_upload				= false;
+bool kProgram_cache				= true;
+std::string kMesh_file;
+bool kMesh_cache				= true;
+int kObject_count				= 1;
+bool kInstanced					= false;
+bool kUbo						= false;
+TextureMode kTexture_mode		= TextureMode::Single;
+int kTarget_fps					= 60;
+bool kReclaim					= false;
+std::string kSweep;
+int kSweep_seconds				= 20;
+std::string kSweep_report		= "logs/sweep.csv";
+bool kAsync_log					= false;
+bool kTrace						= false;
+bool kThreads					= false;
+RespawnPolicy kRespawn_policy	= RespawnPolicy::Burst;
+unsigned long long kRespawn_seed	= 0;
+
+thread_local int kInstance_slot	= -1;
+int kSession_id					= 0;
+thread_local long long kSpawned_at_ns	= 0;
+thread_local long long kSlot_freed_at_ns	= 0;
+int kZygote_fd					= -1;
+thread_local int kReady_handle		= -1;
+
+bool ParseSettings(int argc, const char** argv)
+{
+	enum  optionIndex {
+		OPT_HELP, OPT_NUM_PROCS, OPT_RESPAWN_SECOND, OPT_NUM_TEXTURES, OPT_TEXT_SIZE,
+		OPT_ZYGOTE, OPT_LOCAL_TEXTURES, OPT_PBO, OPT_NO_PROGRAM_CACHE, OPT_MESH, OPT_NO_MESH_CACHE,
+		OPT_OBJECTS, OPT_INSTANCED, OPT_UBO, OPT_TEXTURE_MODE, OPT_FPS, OPT_RECLAIM,
+		OPT_SWEEP, OPT_SWEEP_SECONDS, OPT_SWEEP_REPORT, OPT_ASYNC_LOG, OPT_TRACE, OPT_THREADS,
+		OPT_RESPAWN_POLICY, OPT_RESPAWN_SEED,
+		OPT_INSTANCE, OPT_SESSION, OPT_SPAWNED_AT, OPT_FREED_AT, OPT_ZYGOTE_FD, OPT_READY
+	};
+
+	const option::Descriptor usage[] =
+	{
+		{ 0,  0, 0, option::Arg::Dummy, "USAGE: example [options]\n\n Options:" },
+		{ OPT_HELP,					"h", "help", option::Arg::None,					"  -h,--help           Print usage and exit." },
+		{ OPT_NUM_PROCS,			"c", "count", option::Arg::Numeric,				"  --count, -c         number of processes (default: 5)." },
+		{ OPT_RESPAWN_SECOND,		"r", "respawn", option::Arg::Numeric,			"  --respawn, -r       respawn time in seconds (default: 3)." },
+		{ OPT_RESPAWN_POLICY,		"", "respawn-policy", option::Arg::String,		"  --respawn-policy    burst (default, all children every respawn time), rolling (one every respawn time / count) or poisson." },
+		{ OPT_RESPAWN_SEED,			"", "respawn-seed", option::Arg::String,		"  --respawn-seed      seed of the respawn schedule, the same seed kills the same way again (default: random)." },
+		{ OPT_NUM_TEXTURES,			"t", "textures", option::Arg::Numeric,			"  --textures, -t      texture count (default: 10)." },
+		{ OPT_TEXT_SIZE,			"s", "size", option::Arg::Numeric,				"  --size, -s          texture width (default: 4096)." },
+		{ OPT_ZYGOTE,				"z", "zygote", option::Arg::None,				"  --zygote, -z        fork children from a pre-initialized process (posix only)." },
+		{ OPT_LOCAL_TEXTURES,		"l", "local-textures", option::Arg::None,		"  --local-textures, -l every child fills its own textures instead of sharing the master's." },
+		{ OPT_PBO,					"p", "pbo", option::Arg::None,					"  --pbo, -p           upload textures through a pbo ring, one per frame after the first." },
+		{ OPT_NO_PROGRAM_CACHE,		"", "no-program-cache", option::Arg::None,		"  --no-program-cache  always compile the shaders, don't use the program binary cache." },
+		{ OPT_MESH,					"m", "mesh", option::Arg::String,				"  --mesh, -m          obj file to render instead of the cube." },
+		{ OPT_NO_MESH_CACHE,		"", "no-mesh-cache", option::Arg::None,			"  --no-mesh-cache     always parse the mesh, don't use the binary mesh cache." },
+		{ OPT_OBJECTS,				"o", "objects", option::Arg::Numeric,			"  --objects, -o       objects drawn per frame in every child (default: 1)." },
+		{ OPT_INSTANCED,			"i", "instanced", option::Arg::None,			"  --instanced, -i     draw all objects with one instanced draw instead of one draw each." },
+		{ OPT_UBO,					"u", "ubo", option::Arg::None,					"  --ubo, -u           submit frames through a uniform buffer and a prebuilt vao." },
+		{ OPT_TEXTURE_MODE,			"", "texture-mode", option::Arg::String,		"  --texture-mode      2d (default), array (one 2d array texture) or bindless (ARB_bindless_texture handles)." },
+		{ OPT_FPS,					"f", "fps", option::Arg::Numeric,				"  --fps, -f           frames per second every child paces itself to, 0 for unlimited (default: 60)." },
+		{ OPT_RECLAIM,				"", "reclaim", option::Arg::None,				"  --reclaim           sample driver memory around every kill wave, log reclaim latency and leaked bytes." },
+		{ OPT_SWEEP,				"", "sweep", option::Arg::String,				"  --sweep             run a matrix of settings, e.g. \"count=1,4 textures=10 size=1024,4096 respawn=3\"." },
+		{ OPT_SWEEP_SECONDS,		"", "sweep-seconds", option::Arg::Numeric,		"  --sweep-seconds     how long every configuration of the sweep runs (default: 20)." },
+		{ OPT_SWEEP_REPORT,			"", "sweep-report", option::Arg::String,		"  --sweep-report      where the sweep results go, .json or .csv (default: logs/sweep.csv)." },
+		{ OPT_ASYNC_LOG,			"", "async-log", option::Arg::None,				"  --async-log         every process logs into its own file from a background thread, merged on exit." },
+		{ OPT_TRACE,				"", "trace", option::Arg::None,					"  --trace             write phase, spawn and kill spans to logs/trace.*.bin, see tools/trace2json." },
+		{ OPT_THREADS,				"", "threads", option::Arg::None,				"  --threads           render threads with a context each in the master instead of child processes (posix only)." },
+		{ OPT_INSTANCE,				"", "instance", option::Arg::Numeric,			"  --instance          (internal) child slot assigned by the master." },
+		{ OPT_SESSION,				"", "session", option::Arg::Numeric,			"  --session           (internal) process id of the master." },
+		{ OPT_SPAWNED_AT,			"", "spawned-at", option::Arg::String,			"  --spawned-at        (internal) monotonic time of the spawn request in ns." },
+		{ OPT_FREED_AT,				"", "freed-at", option::Arg::String,			"  --freed-at          (internal) monotonic time the slot was last killed in ns." },
+		{ OPT_ZYGOTE_FD,			"", "zygote-fd", option::Arg::Numeric,			"  --zygote-fd         (internal) control socket of the zygote." },
+		{ OPT_READY,				"", "ready", option::Arg::Numeric,				"  --ready             (internal) readiness channel to signal after the first frame." },
+		{ 0, 0, 0, option::Arg::Dummy,"\nExamples:\n"
+		"  example -h \n"
+		"  example -r \"musthave\" -d -v -n 123 -s \"hello world\" -m=test -m=\"test 2\" -m \"test 3\"\n"
+		"  example \n" },
+		{ 0, 0, 0, option::Arg::End, 0 }	// terminating
+	};
+
+	option::Options opts((option::Descriptor*)usage);
+	if (argc > 0 && !opts.Parse(argv, argc))
+	{
+		LOG(INFO) << "* option error:" <<  opts.error_msg();
+		LOG(INFO) << opts.cstr();
+		return false;
+	}
+
+	if (opts[OPT_HELP])
+	{
+		LOG(INFO) << opts.cstr();
+		return false;
+	}
+
+	if (opts[OPT_NUM_PROCS])
+	{
+
+		opts.GetArgument(OPT_NUM_PROCS, kMax_num_process_count);
+		if (kMax_num_process_count > kMaxNum_Processes)
+		{
+			kMax_num_process_count = kMaxNum_Processes;
+			LOG(INFO) << "invalid process count specified, max process count = " << kMaxNum_Processes;
+		}
+
+	}
+	if (opts[OPT_RESPAWN_SECOND])
+	{
+
+		opts.GetArgument(OPT_RESPAWN_SECOND, kRespawn_time_in_seconds);
+		if (kRespawn_time_in_seconds < 1)
+		{
+			kRespawn_time_in_seconds = 1;
+			LOG(INFO) << "respawn time can't be less than 1 second";
+		}
+		if (kRespawn_time_in_seconds > 30)
+		{
+			kRespawn_time_in_seconds = 30;
+			LOG(INFO) << "respawn time can't be more than 30 second";
+		}
+	}
+
+	if (opts[OPT_NUM_TEXTURES])
+	{
+		opts.GetArgument(OPT_NUM_TEXTURES, kNum_Textures);
+		if (kNum_Textures < 1)
+		{
+			LOG(INFO) << "texture count can't be less than 1";
+			kNum_Textures = 1;
+		}
+
+		if (kNum_Textures > kMaxNum_Textures)
+		{
+			LOG(INFO) << "texture count can't be more than " << kMaxNum_Textures;
+			kNum_Textures = kMaxNum_Textures;
+		}
+
+	}
+
+	if (opts[OPT_TEXT_SIZE])
+	{
+		int tsize = 4096;
+		opts.GetArgument(OPT_TEXT_SIZE, tsize);
+		if (tsize > 4096)
+		{
+			LOG(INFO) << "texture size can't be more than 4096";
+			tsize = 4096;
+		}
+		if (tsize < 256)
+		{
+			LOG(INFO) << "texture size can't be more less 256";
+			tsize = 256;
+		}
+		kTexture_width = tsize;
+		kTexture_size = kTexture_width * kTexture_width * 4;
+	}
+
+	if (opts[OPT_ZYGOTE])
+	{
+#ifdef _WIN32
+		LOG(INFO) << "zygote mode needs fork(), ignored on windows";
+#else
+		kZygote = true;
+#endif
+	}
+
+	if (opts[OPT_LOCAL_TEXTURES])
+	{
+		kShared_textures = false;
+	}
+
+	if (opts[OPT_PBO])
+	{
+		kPbo_upload = true;
+	}
+
+	if (opts[OPT_NO_PROGRAM_CACHE])
+	{
+		kProgram_cache = false;
+	}
+
+	if (opts[OPT_MESH])
+	{
+		const char* mesh = opts.GetValue(OPT_MESH);
+		kMesh_file = mesh ? mesh : "";
+	}
+
+	if (opts[OPT_NO_MESH_CACHE])
+	{
+		kMesh_cache = false;
+	}
+
+	if (opts[OPT_OBJECTS])
+	{
+		opts.GetArgument(OPT_OBJECTS, kObject_count);
+		if (kObject_count < 1)
+		{
+			LOG(INFO) << "object count can't be less than 1";
+			kObject_count = 1;
+		}
+		if (kObject_count > kMaxObject_count)
+		{
+			LOG(INFO) << "object count can't be more than " << kMaxObject_count;
+			kObject_count = kMaxObject_count;
+		}
+	}
+
+	if (opts[OPT_INSTANCED])
+	{
+		kInstanced = true;
+	}
+
+	if (opts[OPT_UBO])
+	{
+		kUbo = true;
+	}
+
+	if (opts[OPT_RESPAWN_POLICY])
+	{
+		if (!ParseRespawnPolicy(opts.GetValue(OPT_RESPAWN_POLICY), kRespawn_policy))
+		{
+			LOG(INFO) << "unknown respawn policy, use burst, rolling or poisson";
+		}
+	}
+
+	if (opts[OPT_RESPAWN_SEED])
+	{
+		// strtoull takes a sign and wraps, a seed is digits only
+		const char* seed = opts.GetValue(OPT_RESPAWN_SEED);
+		char* end = nullptr;
+		errno = 0;
+		unsigned long long value = seed && isdigit((unsigned char)seed[0]) ? strtoull(seed, &end, 10) : 0;
+		if (end == nullptr || *end != '\0' || errno == ERANGE)
+		{
+			LOG(INFO) << "invalid respawn seed, use a decimal number up to " << ULLONG_MAX;
+		}
+		else
+		{
+			kRespawn_seed = value;
+		}
+	}
+
+	if (opts[OPT_TEXTURE_MODE])
+	{
+		const char* mode = opts.GetValue(OPT_TEXTURE_MODE);
+		if (mode && strcmp(mode, "2d") == 0) kTexture_mode = TextureMode::Single;
+		else if (mode && strcmp(mode, "array") == 0) kTexture_mode = TextureMode::Array;
+		else if (mode && strcmp(mode, "bindless") == 0) kTexture_mode = TextureMode::Bindless;
+		else LOG(INFO) << "unknown texture mode, use 2d, array or bindless";
+	}
+
+	if (opts[OPT_FPS])
+	{
+		opts.GetArgument(OPT_FPS, kTarget_fps);
+		if (kTarget_fps < 0)
+		{
+			LOG(INFO) << "target fps can't be negative, rendering unlimited";
+			kTarget_fps = 0;
+		}
+		if (kTarget_fps > kMaxTarget_fps)
+		{
+			LOG(INFO) << "target fps can't be more than " << kMaxTarget_fps;
+			kTarget_fps = kMaxTarget_fps;
+		}
+	}
+
+	if (opts[OPT_RECLAIM])
+	{
+		kReclaim = true;
+	}
+
+	if (opts[OPT_SWEEP])
+	{
+		const char* sweep = opts.GetValue(OPT_SWEEP);
+		kSweep = sweep ? sweep : "";
+	}
+
+	if (opts[OPT_SWEEP_SECONDS])
+	{
+		opts.GetArgument(OPT_SWEEP_SECONDS, kSweep_seconds);
+		if (kSweep_seconds < 1)
+		{
+			LOG(INFO) << "sweep seconds can't be less than 1";
+			kSweep_seconds = 1;
+		}
+	}
+
+	if (opts[OPT_SWEEP_REPORT])
+	{
+		const char* report = opts.GetValue(OPT_SWEEP_REPORT);
+		if (report && *report) kSweep_report = report;
+	}
+
+	if (opts[OPT_ASYNC_LOG])
+	{
+		kAsync_log = true;
+	}
+
+	if (opts[OPT_TRACE])
+	{
+		kTrace = true;
+	}
+
+	if (opts[OPT_THREADS])
+	{
+#ifdef _WIN32
+		LOG(INFO) << "thread mode renders headless through egl, ignored on windows";
+#else
+		kThreads = true;
+#endif
+	}
+
+	if (opts[OPT_INSTANCE])
+	{
+		opts.GetArgument(OPT_INSTANCE, kInstance_slot);
+	}
+
+	if (opts[OPT_SESSION])
+	{
+		opts.GetArgument(OPT_SESSION, kSession_id);
+	}
+
+	if (opts[OPT_SPAWNED_AT])
+	{
+		kSpawned_at_ns = strtoll(opts.GetValue(OPT_SPAWNED_AT), nullptr, 10);
+	}
+
+	if (opts[OPT_FREED_AT])
+	{
+		kSlot_freed_at_ns = strtoll(opts.GetValue(OPT_FREED_AT), nullptr, 10);
+	}
+
+	if (opts[OPT_ZYGOTE_FD])
+	{
+		opts.GetArgument(OPT_ZYGOTE_FD, kZygote_fd);
+	}
+
+	if (opts[OPT_READY])
+	{
+		opts.GetArgument(OPT_READY, kReady_handle);
+	}
+
+	return true;
+}
+
+const char* TextureModeName(TextureMode mode)
+{
+	switch (mode)
+	{
+	case TextureMode::Array:	return "array";
+	case TextureMode::Bindless:	return "bindless";
+	default:					return "2d";
+	}
+}
+
+const char* RespawnPolicyName(RespawnPolicy policy)
+{
+	switch (policy)
+	{
+	case RespawnPolicy::Rolling:	return "rolling";
+	case RespawnPolicy::Poisson:	return "poisson";
+	default:						return "burst";
+	}
+}
+
+bool ParseRespawnPolicy(const char* name, RespawnPolicy& policy)
+{
+	if (name && strcmp(name, "burst") == 0) policy = RespawnPolicy::Burst;
+	else if (name && strcmp(name, "rolling") == 0) policy = RespawnPolicy::Rolling;
+	else if (name && strcmp(name, "poisson") == 0) policy = RespawnPolicy::Poisson;
+	else return false;
+	return true;
+}
+
+#ifdef _WIN32
+
+bool ParseSettings(LPSTR lpCmdLine)
+{
+	int argc;
+	char** argv = option::CommandLineToArgvWin(lpCmdLine, &argc);
+	if (argv == nullptr)
+		return true;	// no arguments at all, keep the defaults
+
+	bool ret = ParseSettings(argc - 1, (const char**)&argv[1]);	// skip first argument (module path)
+	option::free(argv);
+	return ret;
+}
+
+#endif
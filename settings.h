@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// ------------------------------
+// Configuration options (shared by the master and the children, which
+// receive the master's command line plus the internal options below)
+
+extern int			kMax_num_process_count;
+const int			kMaxNum_Processes = 1000;
+extern int			kRespawn_time_in_seconds;
+extern int			kNum_Textures;
+const int			kMaxNum_Textures = 100;
+extern size_t		kTexture_width;
+extern size_t		kTexture_size;
+
+// fork children from a pre-initialized template process (posix only)
+extern bool			kZygote;
+// children upload their textures from pixels the master filled once in shared memory
+extern bool			kShared_textures;
+// stream textures through a pbo ring and start drawing before all of them are uploaded
+extern bool			kPbo_upload;
+// load linked programs from logs/programs instead of compiling them in every child
+extern bool			kProgram_cache;
+// obj file to render instead of the built-in cube, empty for the cube
+extern std::string	kMesh_file;
+// keep the indexed mesh of kMesh_file in logs/meshes and map it instead of parsing again
+extern bool			kMesh_cache;
+// objects drawn per frame, and whether they go out in one instanced draw or one draw each
+extern int			kObject_count;
+const int			kMaxObject_count = 65536;
+extern bool			kInstanced;
+// per-frame values in one uniform buffer update and a vao built once, instead of the original per-frame setup
+extern bool			kUbo;
+
+// how the textures are kept and selected every frame: a 2d texture bound each
+// (the original), layers of one 2d array texture, or resident ARB_bindless_texture handles
+enum class TextureMode
+{
+	Single,
+	Array,
+	Bindless,
+};
+extern TextureMode	kTexture_mode;
+const char*			TextureModeName(TextureMode mode);
+
+// which children the master kills when: all of them every kRespawn_time_in_seconds
+// (the original), one every kRespawn_time_in_seconds / count in turn, or one picked at
+// random at exponentially distributed intervals with the same mean (a poisson process)
+enum class RespawnPolicy
+{
+	Burst,
+	Rolling,
+	Poisson,
+};
+extern RespawnPolicy		kRespawn_policy;
+const char*				RespawnPolicyName(RespawnPolicy policy);
+bool					ParseRespawnPolicy(const char* name, RespawnPolicy& policy);
+// seed of the respawn schedule, 0 picks one (logged, to run the same schedule again)
+extern unsigned long long	kRespawn_seed;
+
+// frames per second a child paces itself to, 0 renders as fast as it can
+extern int			kTarget_fps;
+const int			kMaxTarget_fps = 1000;
+
+// master: sample driver memory around every kill until it settles, log reclaim latency and leaks
+extern bool			kReclaim;
+
+// master: run every combination of the sweep spec for kSweep_seconds each and write a report (posix only)
+extern std::string	kSweep;
+extern int			kSweep_seconds;
+extern std::string	kSweep_report;		// .json for json, csv otherwise
+
+// every process logs into its own file through a lock-free ring and a writer thread
+extern bool			kAsync_log;
+
+// every process writes a binary trace of its phases (and the master of spawns and kills)
+extern bool			kTrace;
+// the master renders on a thread per slot, each with its own context, instead of spawning children (posix only)
+extern bool			kThreads;
+
+// internal, appended by the master to every child it spawns. the per child ones are
+// per thread, a render thread (--threads) sets them like a child process parses them
+extern thread_local int			kInstance_slot;		// -1 in the master
+extern int						kSession_id;		// process id of the master
+extern thread_local long long	kSpawned_at_ns;		// MonotonicNs() when the master asked for this child
+extern thread_local long long	kSlot_freed_at_ns;	// MonotonicNs() when the previous occupant was killed, 0 if none
+extern int						kZygote_fd;			// control socket, only set in the zygote itself
+extern thread_local int			kReady_handle;		// readiness channel: pipe fd (posix) or event id (win32), -1 if none
+
+// parse argv (module path already skipped), returns false when the process should exit
+bool ParseSettings(int argc, const char** argv);
+
+#ifdef _WIN32
+bool ParseSettings(LPSTR lpCmdLine);
+#endif
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "glad.h"
+#include "logging.h"
+#include "settings.h"
+#include "shader_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define PROGRAM_CACHE_DIR "logs\\programs"
+#else
+#include <unistd.h>
+#define PROGRAM_CACHE_DIR "logs/programs"
+#endif
+
+static const uint32_t kProgramCacheMagic = 0x50474f4f;	// "OOGP"
+static const uint32_t kProgramCacheVersion = 1;
+
+struct ProgramCacheHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	format;			// binary format reported by the driver
+	uint32_t	length;
+	int64_t		compile_ns;
+};
+
+// fnv-1a, stable across runs and compilers unlike std::hash
+static uint64_t Fnv1a(uint64_t h, const char* s)
+{
+	for (; s && *s; ++s)
+	{
+		h ^= (unsigned char)*s;
+		h *= 0x100000001b3ull;
+	}
+	return h ^ 0xff;	// separator, so ("ab", "c") and ("a", "bc") differ
+}
+
+static bool ProgramBinarySupported()
+{
+	if (!kProgram_cache || !(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)) return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+static std::filesystem::path CachePath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return std::filesystem::path(PROGRAM_CACHE_DIR) / name;
+}
+
+uint64_t ProgramCacheKey(std::initializer_list<const char*> sources)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (const char* source : sources) h = Fnv1a(h, source);
+	h = Fnv1a(h, (const char*)glGetString(GL_VENDOR));
+	h = Fnv1a(h, (const char*)glGetString(GL_RENDERER));
+	h = Fnv1a(h, (const char*)glGetString(GL_VERSION));
+	return h;
+}
+
+GLuint LoadCachedProgram(uint64_t key, int64_t& saved_ns)
+{
+	if (!ProgramBinarySupported()) return 0;
+
+	std::filesystem::path path = CachePath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return 0;
+
+	ProgramCacheHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != kProgramCacheMagic || header.version != kProgramCacheVersion)
+		return 0;
+	// a truncated or damaged entry must not size the buffer
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(path, ec);
+	if (ec || size < sizeof(header) || header.length != size - sizeof(header))
+		return 0;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+	// the driver is free to reject a binary at any time, we then compile as usual
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		LOG(INFO) << "[" << _instance_name << "] " << "program cache: binary rejected by the driver, recompiling";
+		glDeleteProgram(program);
+		return 0;
+	}
+	saved_ns = header.compile_ns;
+	return program;
+}
+
+void PrepareCachedProgram(GLuint program)
+{
+	if (ProgramBinarySupported())
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+void StoreCachedProgram(uint64_t key, GLuint program, int64_t compile_ns)
+{
+	if (!ProgramBinarySupported()) return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	ProgramCacheHeader header = { kProgramCacheMagic, kProgramCacheVersion, format, (uint32_t)length, compile_ns };
+
+	// children respawn in parallel: write a private file and rename it over the entry
+	std::error_code ec;
+	std::filesystem::create_directories(PROGRAM_CACHE_DIR, ec);
+	std::filesystem::path path = CachePath(key);
+	std::filesystem::path temp = path;
+#ifdef _WIN32
+	temp += "." + std::to_string(::GetCurrentProcessId());
+#else
+	temp += "." + std::to_string(::getpid());
+#endif
+	temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));	// render threads, --threads
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+		if (!file)
+		{
+			LOG(WARNING) << "[" << _instance_name << "] " << "program cache: can't write " << temp.string();
+			file.close();
+			std::filesystem::remove(temp, ec);
+			return;
+		}
+	}
+	std::filesystem::rename(temp, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp, ec);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "glad.h"
+
+#include <initializer_list>
+#include <stdint.h>
+
+// ------------------------------
+// program binary cache: linked programs are stored with glGetProgramBinary under
+// logs/programs/, keyed by a hash of their sources and the gl vendor, renderer and
+// version, so a driver update simply misses instead of loading a stale binary.
+// all of it needs a current context.
+
+// key for the program linked from sources
+uint64_t	ProgramCacheKey(std::initializer_list<const char*> sources);
+
+// a linked program from the cache, 0 on a miss (or without binary support).
+// saved_ns is how long compiling and linking took when the binary was stored
+GLuint		LoadCachedProgram(uint64_t key, int64_t& saved_ns);
+
+// call before glLinkProgram, so the driver keeps the binary around
+void		PrepareCachedProgram(GLuint program);
+
+// store a linked program, compile_ns is reported back by later hits
+void		StoreCachedProgram(uint64_t key, GLuint program, int64_t compile_ns);
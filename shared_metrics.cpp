@@ -0,0 +1,420 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "shared_metrics.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ------------------------------
+// segment layout: header, then one cache line aligned slot per instance slot.
+// the pages come zeroed and a zeroed lock-free atomic is a valid 0, so nothing
+// is constructed in place
+
+static const uint32_t kSharedMetricsMagic = 0x544d4f4f;	// "OOMT"
+static const uint32_t kSharedMetricsVersion = 2;
+static const int kPhaseCount = (int)MetricsPhase::Count;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "metrics slots need address free atomics");
+
+struct SharedMetricsHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	slot_count;
+	uint32_t	slot_size;		// sizeof(MetricsSlot) when created
+};
+
+struct alignas(64) MetricsSlot
+{
+	std::atomic<int64_t>	pid;			// 0 while free
+	std::atomic<uint64_t>	generation;		// bumped by every child claiming the slot
+	std::atomic<int64_t>	phase_ns[kPhaseCount];
+	std::atomic<int64_t>	first_frame_ns;	// MonotonicNs() of the first frame, 0 before
+	std::atomic<uint64_t>	frames;
+	std::atomic<uint64_t>	upload_bytes;
+	std::atomic<uint64_t>	frame_histogram[kFrameHistogramBuckets];
+};
+
+static size_t SlotsOffset()
+{
+	return (sizeof(SharedMetricsHeader) + alignof(MetricsSlot) - 1) / alignof(MetricsSlot) * alignof(MetricsSlot);
+}
+
+static void*		_view = nullptr;
+static size_t		_view_size = 0;
+static bool			_owner = false;
+static thread_local MetricsSlot*	_slot = nullptr;	// the child's own (or render thread's)
+static int64_t		_reported_ns = 0;	// master, last ReportMetrics
+static MetricsTotals	_retired;		// master, children released so far
+#ifdef _WIN32
+static HANDLE		_mapping = NULL;
+#endif
+
+static int ThisProcessId()
+{
+#ifdef _WIN32
+	return (int)::GetCurrentProcessId();
+#else
+	return (int)::getpid();
+#endif
+}
+
+static std::string SegmentName(int session)
+{
+#ifdef _WIN32
+	return "Local\\OutofProcWindowMetrics_" + std::to_string(session);
+#else
+	return "/outofproc_metrics_" + std::to_string(session);
+#endif
+}
+
+static SharedMetricsHeader* Header()
+{
+	return (SharedMetricsHeader*)_view;
+}
+
+static MetricsSlot* Slot(int slot)
+{
+	return (MetricsSlot*)((char*)_view + SlotsOffset()) + slot;
+}
+
+// ------------------------------
+// platform, both ends map it read-write
+
+#ifdef _WIN32
+
+static void* CreateSegment(const std::string& name, size_t size)
+{
+	_mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name.c_str());
+	if (_mapping == NULL)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared metrics: CreateFileMapping failed (" << GetLastError() << ")";
+		return nullptr;
+	}
+	void* view = ::MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+	if (view == nullptr)
+	{
+		::CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+	return view;
+}
+
+static void* OpenSegment(const std::string& name, size_t& size)
+{
+	HANDLE mapping = ::OpenFileMappingA(FILE_MAP_WRITE, FALSE, name.c_str());
+	if (mapping == NULL) return nullptr;
+
+	void* view = ::MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+	::CloseHandle(mapping);	// the view keeps the section alive
+	if (view == nullptr) return nullptr;
+
+	MEMORY_BASIC_INFORMATION info;
+	::VirtualQuery(view, &info, sizeof(info));
+	size = info.RegionSize;
+	return view;
+}
+
+static void CloseSegment(const std::string& name)
+{
+	UNREFERENCED_PARAMETER(name);
+	::UnmapViewOfFile(_view);
+	if (_mapping != NULL)
+	{
+		::CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+}
+
+#else
+
+static void* CreateSegment(const std::string& name, size_t size)
+{
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST)
+	{
+		// left behind by a master that got killed, and our pid got reused
+		::shm_unlink(name.c_str());
+		fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+	if (fd < 0)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared metrics: shm_open failed (" << strerror(errno) << ")";
+		return nullptr;
+	}
+
+	void* view = ::ftruncate(fd, (off_t)size) == 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (view == MAP_FAILED)
+	{
+		::shm_unlink(name.c_str());
+		return nullptr;
+	}
+	return view;
+}
+
+static void* OpenSegment(const std::string& name, size_t& size)
+{
+	int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0) return nullptr;
+
+	struct stat st;
+	void* view = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		size = (size_t)st.st_size;
+		view = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	return view == MAP_FAILED ? nullptr : view;
+}
+
+static void CloseSegment(const std::string& name)
+{
+	::munmap(_view, _view_size);
+	if (_owner) ::shm_unlink(name.c_str());
+}
+
+#endif
+
+// ------------------------------
+// master
+
+bool CreateSharedMetrics()
+{
+	if (_view != nullptr) return true;
+
+	uint32_t slots = (uint32_t)std::max(kMax_num_process_count, 1);
+	size_t size = SlotsOffset() + slots * sizeof(MetricsSlot);
+	void* view = CreateSegment(SegmentName(ThisProcessId()), size);
+	if (view == nullptr) return false;
+
+	SharedMetricsHeader* header = (SharedMetricsHeader*)view;
+	header->slot_count = slots;
+	header->slot_size = sizeof(MetricsSlot);
+	header->version = kSharedMetricsVersion;
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = kSharedMetricsMagic;
+
+	_view = view;
+	_view_size = size;
+	_owner = true;
+	_reported_ns = MonotonicNs();
+	_retired = MetricsTotals();
+	return true;
+}
+
+void DestroySharedMetrics()
+{
+	if (_view == nullptr) return;
+	CloseSegment(SegmentName(ThisProcessId()));
+	_view = nullptr;
+	_view_size = 0;
+	_owner = false;
+	_slot = nullptr;
+}
+
+void ReleaseMetricsSlot(int slot)
+{
+	if (!_owner || slot < 0 || slot >= (int)Header()->slot_count) return;
+	MetricsSlot* s = Slot(slot);
+	if (s->pid.load(std::memory_order_acquire) == 0) return;
+
+	// what it did goes into the totals before the next child clears the slot
+	int64_t first_frame_ns = s->first_frame_ns.load(std::memory_order_relaxed);
+	_retired.frames += s->frames.load(std::memory_order_relaxed);
+	if (first_frame_ns != 0) _retired.child_seconds += (MonotonicNs() - first_frame_ns) / 1e9;
+	s->pid.store(0, std::memory_order_release);
+}
+
+MetricsTotals ReadMetricsTotals()
+{
+	MetricsTotals totals = _retired;
+	if (!_owner) return totals;
+
+	int64_t now = MonotonicNs();
+	for (uint32_t s = 0; s < Header()->slot_count; ++s)
+	{
+		MetricsSlot* slot = Slot((int)s);
+		if (slot->pid.load(std::memory_order_acquire) == 0) continue;
+		int64_t first_frame_ns = slot->first_frame_ns.load(std::memory_order_relaxed);
+		totals.frames += slot->frames.load(std::memory_order_relaxed);
+		if (first_frame_ns != 0) totals.child_seconds += (now - first_frame_ns) / 1e9;
+	}
+	return totals;
+}
+
+// per slot, what the previous report saw
+struct SlotSample
+{
+	uint64_t	generation = 0;
+	uint64_t	frames = 0;
+};
+
+// the upper bound of the bucket the p-th frame falls into, in ms
+static double HistogramPercentile(const uint64_t* histogram, uint64_t total, double p)
+{
+	uint64_t rank = (uint64_t)(total * p), seen = 0;
+	for (int b = 0; b < kFrameHistogramBuckets; ++b)
+	{
+		seen += histogram[b];
+		if (seen > rank) return (double)(1ll << b);
+	}
+	return (double)(1ll << (kFrameHistogramBuckets - 1));
+}
+
+void ReportMetrics()
+{
+	if (!_owner) return;
+
+	static std::vector<SlotSample> previous;
+	int64_t now = MonotonicNs();
+	double elapsed = std::max((now - _reported_ns) / 1e9, 1e-3);
+	_reported_ns = now;
+
+	uint32_t slot_count = Header()->slot_count;
+	previous.resize(slot_count);
+
+	size_t children = 0;
+	uint64_t frames = 0, upload_bytes = 0;
+	double min_fps = 0, max_fps = 0;
+	uint64_t histogram[kFrameHistogramBuckets] = {};
+	int64_t phase_ns[kPhaseCount] = {};
+	size_t phase_children[kPhaseCount] = {};
+	for (uint32_t s = 0; s < slot_count; ++s)
+	{
+		MetricsSlot* slot = Slot((int)s);
+		if (slot->pid.load(std::memory_order_acquire) == 0) continue;
+
+		// a respawned child starts counting from 0 again
+		uint64_t generation = slot->generation.load(std::memory_order_relaxed);
+		uint64_t slot_frames = slot->frames.load(std::memory_order_relaxed);
+		uint64_t since = previous[s].generation == generation ? previous[s].frames : 0;
+		double fps = (slot_frames - std::min(since, slot_frames)) / elapsed;
+		previous[s].generation = generation;
+		previous[s].frames = slot_frames;
+
+		min_fps = children == 0 ? fps : std::min(min_fps, fps);
+		max_fps = std::max(max_fps, fps);
+		children++;
+		frames += slot_frames;
+		upload_bytes += slot->upload_bytes.load(std::memory_order_relaxed);
+		for (int b = 0; b < kFrameHistogramBuckets; ++b) histogram[b] += slot->frame_histogram[b].load(std::memory_order_relaxed);
+		for (int p = 0; p < kPhaseCount; ++p)
+		{
+			int64_t ns = slot->phase_ns[p].load(std::memory_order_relaxed);
+			if (ns <= 0) continue;
+			phase_ns[p] += ns;
+			phase_children[p]++;
+		}
+	}
+	if (children == 0) return;
+
+	uint64_t timed = 0;
+	for (int b = 0; b < kFrameHistogramBuckets; ++b) timed += histogram[b];
+	static const char* names[kPhaseCount] = { "process", "context", "shaders", "mesh", "textures", "first frame" };
+	std::string phases;
+	for (int p = 0; p < kPhaseCount; ++p)
+	{
+		if (phase_children[p] == 0) continue;
+		char phase[64];
+		snprintf(phase, sizeof(phase), "%s%s %.2f", phases.empty() ? "" : ", ", names[p], NsToMs(phase_ns[p] / (int64_t)phase_children[p]));
+		phases += phase;
+	}
+	LOG(INFO) << "[" << _instance_name << "] " << "metrics: " << children << " children, " << frames << " frames, fps per child " << min_fps << " - " << max_fps
+		<< ", frame time p50 < " << HistogramPercentile(histogram, timed, 0.5) << " ms, p99 < " << HistogramPercentile(histogram, timed, 0.99)
+		<< " ms, " << upload_bytes / (1024 * 1024) << "mb uploaded";
+	LOG(INFO) << "[" << _instance_name << "] " << "metrics: mean startup phases (ms): " << phases;
+}
+
+// ------------------------------
+// child
+
+bool MapSharedMetrics()
+{
+	if (_view != nullptr) return true;
+	if (kSession_id == 0) return false;
+
+	size_t size = 0;
+	void* view = OpenSegment(SegmentName(kSession_id), size);
+	if (view == nullptr) return false;
+
+	const SharedMetricsHeader* header = (const SharedMetricsHeader*)view;
+	bool valid = size >= sizeof(SharedMetricsHeader)
+		&& header->magic == kSharedMetricsMagic && header->version == kSharedMetricsVersion
+		&& header->slot_size == sizeof(MetricsSlot)
+		&& SlotsOffset() + header->slot_count * sizeof(MetricsSlot) <= size;
+	if (!valid)
+	{
+		LOG(WARNING) << "[" << _instance_name << "] " << "shared metrics: segment from another build, ignored";
+#ifdef _WIN32
+		::UnmapViewOfFile(view);
+#else
+		::munmap(view, size);
+#endif
+		return false;
+	}
+
+	_view = view;
+	_view_size = size;
+	return true;
+}
+
+bool OpenMetricsSlot(int slot)
+{
+	if (!MapSharedMetrics()) return false;
+	if (slot < 0 || slot >= (int)Header()->slot_count) return false;
+
+	// hidden from the master until the previous child's numbers are gone
+	MetricsSlot* s = Slot(slot);
+	s->pid.store(0, std::memory_order_relaxed);
+	for (int p = 0; p < kPhaseCount; ++p) s->phase_ns[p].store(0, std::memory_order_relaxed);
+	s->first_frame_ns.store(0, std::memory_order_relaxed);
+	s->frames.store(0, std::memory_order_relaxed);
+	s->upload_bytes.store(0, std::memory_order_relaxed);
+	for (int b = 0; b < kFrameHistogramBuckets; ++b) s->frame_histogram[b].store(0, std::memory_order_relaxed);
+	// the slot's only writer like below, no locked add for the bump either
+	s->generation.store(s->generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	s->pid.store(ThisProcessId(), std::memory_order_release);
+	_slot = s;
+
+	if (kSpawned_at_ns != 0) RecordPhase(MetricsPhase::Process, MonotonicNs() - kSpawned_at_ns);
+	return true;
+}
+
+void RecordPhase(MetricsPhase phase, int64_t ns)
+{
+	if (_slot == nullptr) return;
+	_slot->phase_ns[(int)phase].store(std::max<int64_t>(ns, 1), std::memory_order_relaxed);
+	if (phase == MetricsPhase::FirstFrame) _slot->first_frame_ns.store(MonotonicNs(), std::memory_order_relaxed);
+}
+
+void RecordFrame(int64_t frame_ns)
+{
+	if (_slot == nullptr) return;
+	// the only writer, so plain load + store instead of a locked add
+	int b = 0;
+	for (int64_t ms = frame_ns / 1000000; ms > 0 && b < kFrameHistogramBuckets - 1; ms >>= 1) ++b;
+	_slot->frame_histogram[b].store(_slot->frame_histogram[b].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	_slot->frames.store(_slot->frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void RecordUpload(size_t bytes)
+{
+	if (_slot == nullptr) return;
+	_slot->upload_bytes.store(_slot->upload_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------
+// shared metrics: a fixed layout segment the master creates next to the shared
+// textures (named after its process id as well), one slot per instance slot.
+// every child writes its own slot with relaxed atomic stores, nothing is locked,
+// and the master reads all of them live. a slot is claimed again by every child
+// that respawns into it, its generation tells the master a new child is there.
+
+// startup phases of a child, each in ns
+enum class MetricsPhase
+{
+	Process,		// spawn request -> main
+	Context,		// creating the gl context
+	Shaders,		// program compiled or loaded from the cache
+	Mesh,			// mesh parsed or mapped (done in the zygote when there is one)
+	Textures,		// texture storage allocated -> every texture resident
+	FirstFrame,		// spawn request -> first frame presented
+	Count,
+};
+
+// frame times in powers of two of a millisecond: bucket 0 is < 1 ms, bucket b
+// is [2^(b-1), 2^b) ms, the last one takes everything longer
+const int	kFrameHistogramBuckets = 12;
+
+// master: create the segment for kMax_num_process_count slots
+bool	CreateSharedMetrics();
+// master: unmap and remove the name
+void	DestroySharedMetrics();
+// master: the child in slot is gone, drop it from the aggregate
+void	ReleaseMetricsSlot(int slot);
+// master: log the aggregate over every live child, rates are since the last call
+void	ReportMetrics();
+
+// master: everything rendered since the segment was created, killed children included
+struct MetricsTotals
+{
+	uint64_t	frames = 0;
+	double		child_seconds = 0;	// summed over children, from their first frame on
+};
+MetricsTotals	ReadMetricsTotals();
+
+// child: map the segment of master kSession_id read-write, safe to run before a fork
+bool	MapSharedMetrics();
+// child: claim slot (mapping the segment if needed), false when there's no segment or no room
+bool	OpenMetricsSlot(int slot);
+
+// child: cheap no-ops without a slot
+void	RecordPhase(MetricsPhase phase, int64_t ns);
+void	RecordFrame(int64_t frame_ns);
+void	RecordUpload(size_t bytes);
@@ -0,0 +1,272 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "shared_textures.h"
+#include "texture_fill.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ------------------------------
+// segment layout: header, then one page aligned image per texture
+
+static const uint32_t kSharedTexturesMagic = 0x58544f4f;	// "OOTX"
+static const uint32_t kSharedTexturesVersion = 1;
+static const size_t kPageSize = 4096;
+
+struct SharedTexturesHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	count;
+	uint32_t	width;
+	uint64_t	offset;		// first image
+	uint64_t	stride;		// between images
+};
+
+static size_t AlignUp(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+static size_t SegmentSize(size_t count, size_t stride)
+{
+	return AlignUp(sizeof(SharedTexturesHeader), kPageSize) + count * stride;
+}
+
+static void*	_view = nullptr;
+static size_t	_view_size = 0;
+static bool		_owner = false;
+#ifdef _WIN32
+static HANDLE	_mapping = NULL;
+#endif
+
+// children know the master by its process id (--session)
+static int ThisProcessId()
+{
+#ifdef _WIN32
+	return (int)::GetCurrentProcessId();
+#else
+	return (int)::getpid();
+#endif
+}
+
+static std::string SegmentName(int session)
+{
+#ifdef _WIN32
+	return "Local\\OutofProcWindowTextures_" + std::to_string(session);
+#else
+	return "/outofproc_textures_" + std::to_string(session);
+#endif
+}
+
+// ------------------------------
+// platform
+
+#ifdef _WIN32
+
+static void* CreateSegment(const std::string& name, size_t size)
+{
+	_mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+	if (_mapping == NULL)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared textures: CreateFileMapping failed (" << GetLastError() << ")";
+		return nullptr;
+	}
+	void* view = ::MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+	if (view == nullptr)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared textures: MapViewOfFile failed (" << GetLastError() << ")";
+		::CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+	return view;
+}
+
+static void* OpenSegment(const std::string& name, size_t& size)
+{
+	HANDLE mapping = ::OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (mapping == NULL) return nullptr;
+
+	void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	::CloseHandle(mapping);	// the view keeps the section alive
+	if (view == nullptr) return nullptr;
+
+	MEMORY_BASIC_INFORMATION info;
+	::VirtualQuery(view, &info, sizeof(info));
+	size = info.RegionSize;
+	return view;
+}
+
+static void CloseSegment(const std::string& name)
+{
+	UNREFERENCED_PARAMETER(name);	// the section goes away with its last handle and view
+	::UnmapViewOfFile(_view);
+	if (_mapping != NULL)
+	{
+		::CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+}
+
+#else
+
+static void* CreateSegment(const std::string& name, size_t size)
+{
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST)
+	{
+		// left behind by a master that got killed, and our pid got reused
+		::shm_unlink(name.c_str());
+		fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+	if (fd < 0)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared textures: shm_open failed (" << strerror(errno) << ")";
+		return nullptr;
+	}
+
+	// reserve the pages up front, a full tmpfs would otherwise SIGBUS in the middle of the fill
+	int err = ::ftruncate(fd, (off_t)size) < 0 ? errno : ::posix_fallocate(fd, 0, (off_t)size);
+	void* view = err == 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if (view == MAP_FAILED && err == 0) err = errno;
+	::close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "shared textures: can't allocate " << size / (1024 * 1024) << "mb (" << strerror(err) << ")";
+		::shm_unlink(name.c_str());
+		return nullptr;
+	}
+	return view;
+}
+
+static void* OpenSegment(const std::string& name, size_t& size)
+{
+	int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return nullptr;
+
+	struct stat st;
+	void* view = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		size = (size_t)st.st_size;
+		// fault the whole segment in at once, the uploads read every page anyway
+		view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+	}
+	::close(fd);
+	return view == MAP_FAILED ? nullptr : view;
+}
+
+static void CloseSegment(const std::string& name)
+{
+	::munmap(_view, _view_size);
+	if (_owner) ::shm_unlink(name.c_str());
+}
+
+#endif
+
+// ------------------------------
+// master
+
+bool CreateSharedTextures()
+{
+	if (_view != nullptr) return true;
+
+	size_t stride = AlignUp(kTexture_size, kPageSize);
+	size_t size = SegmentSize(kNum_Textures, stride);
+
+	int64_t start = MonotonicNs();
+	void* view = CreateSegment(SegmentName(ThisProcessId()), size);
+	if (view == nullptr) return false;
+
+	SharedTexturesHeader* header = (SharedTexturesHeader*)view;
+	header->count = kNum_Textures;
+	header->width = (uint32_t)kTexture_width;
+	header->offset = AlignUp(sizeof(SharedTexturesHeader), kPageSize);
+	header->stride = stride;
+
+	std::mt19937 gen;
+	gen.seed(static_cast<uint32_t>(time(nullptr)));
+	ThreadPool fill_pool;
+	for (int t = 0; t < kNum_Textures; ++t)
+	{
+		unsigned val = (unsigned int)(gen()) | 0x000000ff;
+		FillChecker((uint32_t*)((char*)view + header->offset + t * stride), kTexture_width, val, &fill_pool);
+	}
+
+	// children check the magic last
+	header->version = kSharedTexturesVersion;
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = kSharedTexturesMagic;
+
+	_view = view;
+	_view_size = size;
+	_owner = true;
+	LOG(INFO) << "[" << _instance_name << "] " << "shared textures: " << kNum_Textures << " x " << kTexture_width << "px (" << size / (1024 * 1024)
+		<< "mb) filled in " << NsToMs(MonotonicNs() - start) << " ms";
+	return true;
+}
+
+void DestroySharedTextures()
+{
+	if (_view == nullptr) return;
+	CloseSegment(SegmentName(ThisProcessId()));
+	_view = nullptr;
+	_view_size = 0;
+	_owner = false;
+}
+
+// ------------------------------
+// child
+
+bool MapSharedTextures()
+{
+	if (_view != nullptr) return true;
+	if (kSession_id == 0) return false;
+
+	size_t size = 0;
+	void* view = OpenSegment(SegmentName(kSession_id), size);
+	if (view == nullptr) return false;
+
+	// a segment from a master with other settings (or half written) is no use, fill locally
+	const SharedTexturesHeader* header = (const SharedTexturesHeader*)view;
+	bool valid = size >= sizeof(SharedTexturesHeader)
+		&& header->magic == kSharedTexturesMagic && header->version == kSharedTexturesVersion
+		&& header->count >= (uint32_t)kNum_Textures && header->width == kTexture_width
+		&& header->offset + header->count * header->stride <= size;
+	if (!valid)
+	{
+		LOG(WARNING) << "[" << _instance_name << "] " << "shared textures: segment doesn't match the settings, ignored";
+#ifdef _WIN32
+		::UnmapViewOfFile(view);
+#else
+		::munmap(view, size);
+#endif
+		return false;
+	}
+
+	_view = view;
+	_view_size = size;
+	return true;
+}
+
+const void* SharedTexture(int t)
+{
+	if (_view == nullptr) return nullptr;
+	const SharedTexturesHeader* header = (const SharedTexturesHeader*)_view;
+	return (const char*)_view + header->offset + t * header->stride;
+}
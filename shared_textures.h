@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+// ------------------------------
+// shared texture source: the master fills the pixels of every texture once into a
+// named shared memory segment (shm_open on posix, a pagefile backed file mapping on
+// win32), children map it read-only and upload straight from the mapping.
+// the segment is named after the master's process id, so children find it through
+// --session without any extra arguments.
+
+// master: create and fill the segment for kNum_Textures x kTexture_width
+bool		CreateSharedTextures();
+
+// master: unmap and remove the name, children that already mapped it keep their view
+void		DestroySharedTextures();
+
+// child: map the segment of master kSession_id read-only, safe to run before a fork.
+// false when there is none, the child then fills its textures itself
+bool		MapSharedTextures();
+
+// pixels of texture t, nullptr when nothing is mapped
+const void*	SharedTexture(int t);
@@ -5,18 +5,22 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 
 // Windows Header Files:
 #include <windows.h>
+#endif
 
 // C RunTime Header Files
 #include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
+#ifdef _WIN32
 #include <tchar.h>
+#endif
 
 
 // TODO: reference additional headers your program requires here
@@ -0,0 +1,197 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "sweep.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+// ------------------------------
+// spec
+
+static bool ParseValues(const std::string& list, std::vector<int>& values)
+{
+	values.clear();
+	size_t at = 0;
+	while (at <= list.size())
+	{
+		size_t comma = list.find(',', at);
+		if (comma == std::string::npos) comma = list.size();
+		std::string value = list.substr(at, comma - at);
+		char* end = nullptr;
+		long v = strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end != 0 || v < 0) return false;
+		values.push_back((int)v);
+		at = comma + 1;
+	}
+	return !values.empty();
+}
+
+static bool ParsePolicies(const std::string& list, std::vector<RespawnPolicy>& policies)
+{
+	policies.clear();
+	size_t at = 0;
+	while (at <= list.size())
+	{
+		size_t comma = list.find(',', at);
+		if (comma == std::string::npos) comma = list.size();
+		RespawnPolicy policy;
+		if (!ParseRespawnPolicy(list.substr(at, comma - at).c_str(), policy)) return false;
+		policies.push_back(policy);
+		at = comma + 1;
+	}
+	return !policies.empty();
+}
+
+bool ParseSweep(const char* spec, std::vector<SweepConfig>& configs)
+{
+	std::vector<int> counts = { kMax_num_process_count }, textures = { kNum_Textures }, sizes = { (int)kTexture_width }, respawns = { kRespawn_time_in_seconds };
+	std::vector<RespawnPolicy> policies = { kRespawn_policy };
+
+	std::string text = spec ? spec : "";
+	for (char& c : text)
+	{
+		if (c == ';') c = ' ';
+	}
+	size_t at = 0;
+	while ((at = text.find_first_not_of(' ', at)) != std::string::npos)
+	{
+		size_t end = text.find(' ', at);
+		if (end == std::string::npos) end = text.size();
+		std::string group = text.substr(at, end - at);
+		at = end;
+
+		size_t equals = group.find('=');
+		std::string name = group.substr(0, equals);
+		if (name == "policy" && equals != std::string::npos && ParsePolicies(group.substr(equals + 1), policies))
+		{
+			continue;
+		}
+		std::vector<int>* values = name == "count" ? &counts : name == "textures" ? &textures : name == "size" ? &sizes : name == "respawn" ? &respawns : nullptr;
+		if (equals == std::string::npos || values == nullptr || !ParseValues(group.substr(equals + 1), *values))
+		{
+			LOG(ERROR) << "[" << _instance_name << "] " << "sweep: can't read \"" << group << "\", expected count|textures|size|respawn|policy=value[,value...]";
+			return false;
+		}
+	}
+
+	configs.clear();
+	for (int count : counts)
+		for (int texture_count : textures)
+			for (int size : sizes)
+				for (int respawn : respawns)
+					for (RespawnPolicy policy : policies)
+						configs.push_back({ count, texture_count, size, respawn, policy });
+	return true;
+}
+
+std::vector<std::string> SweepArguments(int argc, char** argv, const SweepConfig& config)
+{
+	static const char* kSwept[] = { "--count", "-c", "--textures", "-t", "--size", "-s", "--respawn", "-r", "--respawn-policy" };
+
+	std::vector<std::string> arguments;
+	for (int i = 0; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		std::string name = argument.substr(0, argument.find('='));
+		bool swept = i > 0 && std::find(std::begin(kSwept), std::end(kSwept), name) != std::end(kSwept);
+		if (!swept)
+		{
+			arguments.push_back(argument);
+		}
+		else if (name.size() == argument.size())
+		{
+			++i;	// "--count 4" rather than "--count=4"
+		}
+	}
+	arguments.insert(arguments.end(), { "--count", std::to_string(config.count), "--textures", std::to_string(config.textures),
+		"--size", std::to_string(config.size), "--respawn", std::to_string(config.respawn), "--respawn-policy", RespawnPolicyName(config.policy) });
+	return arguments;
+}
+
+// ------------------------------
+// report
+
+static const char* kColumns[] = {
+	"driver", "count", "textures", "size", "respawn", "policy", "seconds", "spawned", "spawn_failures", "spawn_ms",
+	"ready", "ready_failures", "first_frame_ms", "fps", "reaped", "reap_ms", "wave_ms", "wave_worst_ms", "kills", "memory_mb", "memory_peak_mb", "reclaim_kills", "reclaim_ms", "reclaim_worst_ms", "leaked_mb",
+};
+
+static std::string Quoted(const std::string& text, bool json);
+
+// every column but the driver, numbers and the policy name (quoted in json)
+static std::vector<std::string> Values(const SweepResult& r, bool json)
+{
+	auto number = [](double v)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%.3f", v);
+		return std::string(text);
+	};
+	return {
+		std::to_string(r.config.count), std::to_string(r.config.textures), std::to_string(r.config.size), std::to_string(r.config.respawn),
+		json ? Quoted(RespawnPolicyName(r.config.policy), true) : RespawnPolicyName(r.config.policy), number(r.seconds), std::to_string(r.spawned), std::to_string(r.spawn_failures), number(r.spawn_ms),
+		std::to_string(r.ready), std::to_string(r.ready_failures), number(r.first_frame_ms), number(r.fps),
+		std::to_string(r.reaped), number(r.reap_ms), number(r.wave_ms), number(r.wave_worst_ms),
+		std::to_string(r.kills), number(r.memory_mb), number(r.memory_peak_mb), std::to_string(r.reclaim_kills), number(r.reclaim_ms), number(r.reclaim_worst_ms), number(r.leaked_mb),
+	};
+}
+
+// quotes (and for json backslashes) are all a renderer string could need escaping
+static std::string Quoted(const std::string& text, bool json)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"') quoted += json ? '\\' : '"';
+		else if (c == '\\' && json) quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+bool WriteSweepReport(const std::string& path, const std::string& driver, const std::vector<SweepResult>& results)
+{
+	std::error_code ec;
+	std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+	std::ofstream file(path, std::ios::trunc);
+	bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+	const size_t columns = sizeof(kColumns) / sizeof(kColumns[0]);
+	if (json)
+	{
+		file << "[\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			std::vector<std::string> values = Values(results[i], true);
+			file << "\t{ " << Quoted(kColumns[0], true) << ": " << Quoted(driver, true);
+			for (size_t c = 1; c < columns; ++c) file << ", " << Quoted(kColumns[c], true) << ": " << values[c - 1];
+			file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "]\n";
+	}
+	else
+	{
+		for (size_t c = 0; c < columns; ++c) file << (c ? "," : "") << kColumns[c];
+		file << "\n";
+		for (const SweepResult& result : results)
+		{
+			file << Quoted(driver, false);
+			for (const std::string& value : Values(result, false)) file << "," << value;
+			file << "\n";
+		}
+	}
+
+	if (!file)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "sweep: can't write " << path;
+		return false;
+	}
+	return true;
+}
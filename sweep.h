@@ -0,0 +1,61 @@
+#pragma once
+
+#include "settings.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// ------------------------------
+// scenario sweep: the cartesian product of a few values per setting, every
+// configuration run by the master for a fixed time, one row of results each.
+// the spec lists setting=values groups, separated by spaces or semicolons:
+//
+//	count=1,4,8 textures=10 size=1024,4096 respawn=3 policy=burst,rolling,poisson
+//
+// settings left out keep whatever the command line says.
+
+struct SweepConfig
+{
+	int				count;
+	int				textures;
+	int				size;
+	int				respawn;
+	RespawnPolicy	policy;
+};
+
+struct SweepResult
+{
+	SweepConfig	config;
+	double		seconds = 0;
+	size_t		spawned = 0;
+	size_t		spawn_failures = 0;
+	double		spawn_ms = 0;			// mean, launching a child
+	size_t		ready = 0;
+	size_t		ready_failures = 0;
+	double		first_frame_ms = 0;		// mean, spawn request -> first frame
+	double		fps = 0;				// mean per child, from the shared metrics
+	size_t		reaped = 0;
+	double		reap_ms = 0;			// mean, kill -> reaped
+	double		wave_ms = 0;			// mean, first kill of a wave -> last child reaped
+	double		wave_worst_ms = 0;
+	size_t		kills = 0;				// by the respawn schedule
+	double		memory_mb = 0;			// driver memory above idle in steady state, mean
+	double		memory_peak_mb = 0;
+	size_t		reclaim_kills = 0;		// --reclaim only
+	double		reclaim_ms = 0;			// mean per kill wave, kill -> driver memory settled
+	double		reclaim_worst_ms = 0;
+	double		leaked_mb = 0;
+};
+
+// expand spec around the current settings, false (and logged) on a malformed spec
+bool	ParseSweep(const char* spec, std::vector<SweepConfig>& configs);
+
+// the master's command line (module path included) with the settings of config in place
+// of whatever it said for them, options can't be given twice
+std::vector<std::string>	SweepArguments(int argc, char** argv, const SweepConfig& config);
+
+// csv, or json when path ends in .json. driver (GL_RENDERER and GL_VERSION) goes into
+// every row, so reports of different driver versions can be diffed as they are
+bool	WriteSweepReport(const std::string& path, const std::string& driver, const std::vector<SweepResult>& results);
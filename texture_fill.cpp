@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include "texture_fill.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FILL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// msvc accepts any intrinsic without /arch, gcc/clang need the target per function
+#if defined(FILL_X86) && defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+static const uint32_t kCheckerGrey = 0x88888888;
+
+// ------------------------------
+// span kernels, n pixels of value v. Stream bypasses the caches: a texture is far
+// bigger than them and only read back by the upload. streaming pays off only on
+// whole cache lines though, a partially written line costs more than it saves
+
+static void FillSpanScalar(uint32_t* p, size_t n, uint32_t v)
+{
+	for (size_t i = 0; i < n; ++i) p[i] = v;
+}
+
+#ifdef FILL_X86
+
+template <bool Stream>
+TARGET_SSE2 static inline void Store(__m128i* p, __m128i v)
+{
+	if (Stream) _mm_stream_si128(p, v);
+	else _mm_store_si128(p, v);
+}
+
+template <bool Stream>
+TARGET_AVX2 static inline void Store(__m256i* p, __m256i v)
+{
+	if (Stream) _mm256_stream_si256(p, v);
+	else _mm256_store_si256(p, v);
+}
+
+template <bool Stream>
+TARGET_SSE2 static void FillSpanSSE2(uint32_t* p, size_t n, uint32_t v)
+{
+	for (; n && ((uintptr_t)p & 15); --n) *p++ = v;
+
+	__m128i vv = _mm_set1_epi32((int)v);
+	for (; n >= 16; n -= 16, p += 16)
+	{
+		Store<Stream>((__m128i*)p, vv);
+		Store<Stream>((__m128i*)(p + 4), vv);
+		Store<Stream>((__m128i*)(p + 8), vv);
+		Store<Stream>((__m128i*)(p + 12), vv);
+	}
+	for (; n >= 4; n -= 4, p += 4) Store<Stream>((__m128i*)p, vv);
+	for (; n; --n) *p++ = v;
+}
+
+template <bool Stream>
+TARGET_AVX2 static void FillSpanAVX2(uint32_t* p, size_t n, uint32_t v)
+{
+	for (; n && ((uintptr_t)p & 31); --n) *p++ = v;
+
+	__m256i vv = _mm256_set1_epi32((int)v);
+	for (; n >= 32; n -= 32, p += 32)
+	{
+		Store<Stream>((__m256i*)p, vv);
+		Store<Stream>((__m256i*)(p + 8), vv);
+		Store<Stream>((__m256i*)(p + 16), vv);
+		Store<Stream>((__m256i*)(p + 24), vv);
+	}
+	for (; n >= 8; n -= 8, p += 8) Store<Stream>((__m256i*)p, vv);
+	for (; n; --n) *p++ = v;
+}
+
+#endif
+
+// cell (cx, cy) is grey when cx + cy is even, every row is a run of cell wide spans
+template <void (*Span)(uint32_t*, size_t, uint32_t)>
+static void FillRows(uint32_t* pixels, size_t wh, size_t y0, size_t y1, uint32_t color)
+{
+	const size_t check_size = std::max<size_t>(wh / 32, 1);
+	for (size_t y = y0; y < y1; ++y)
+	{
+		uint32_t* row = pixels + y * wh;
+		bool grey = ((y / check_size) & 1) == 0;
+		for (size_t x = 0; x < wh; x += check_size, grey = !grey)
+		{
+			Span(row + x, std::min(check_size, wh - x), grey ? kCheckerGrey : color);
+		}
+	}
+}
+
+// ------------------------------
+// cpu detection
+
+#ifdef FILL_X86
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6) return false;	// os saves the ymm registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool FillKernelSupported(FillKernel kernel)
+{
+	switch (kernel)
+	{
+	case FillKernel::Scalar:	return true;
+#ifdef FILL_X86
+	case FillKernel::SSE2:		return true;	// baseline on x64, and on every x86 that can run gl 3.3
+	case FillKernel::AVX2:
+	{
+		static const bool avx2 = CpuHasAVX2();
+		return avx2;
+	}
+#endif
+	default:					return false;
+	}
+}
+
+FillKernel BestFillKernel()
+{
+	if (FillKernelSupported(FillKernel::AVX2)) return FillKernel::AVX2;
+	if (FillKernelSupported(FillKernel::SSE2)) return FillKernel::SSE2;
+	return FillKernel::Scalar;
+}
+
+const char* FillKernelName(FillKernel kernel)
+{
+	switch (kernel)
+	{
+	case FillKernel::SSE2:	return "sse2";
+	case FillKernel::AVX2:	return "avx2";
+	default:				return "scalar";
+	}
+}
+
+// ------------------------------
+// fill
+
+// every span starts on a cache line and covers whole lines
+static bool LineAligned(const uint32_t* pixels, size_t wh)
+{
+	const size_t check_size = std::max<size_t>(wh / 32, 1);
+	return ((uintptr_t)pixels % kTextureAlignment) == 0 && (wh * 4) % kTextureAlignment == 0 && (check_size * 4) % kTextureAlignment == 0;
+}
+
+void FillCheckerRows(uint32_t* pixels, size_t wh, size_t y0, size_t y1, uint32_t color, FillKernel kernel)
+{
+	if (!FillKernelSupported(kernel)) kernel = FillKernel::Scalar;
+
+	switch (kernel)
+	{
+#ifdef FILL_X86
+	case FillKernel::SSE2:
+		if (LineAligned(pixels, wh))
+		{
+			FillRows<FillSpanSSE2<true>>(pixels, wh, y0, y1, color);
+			_mm_sfence();	// streaming stores are weakly ordered, publish them before the band is handed back
+		}
+		else
+		{
+			FillRows<FillSpanSSE2<false>>(pixels, wh, y0, y1, color);
+		}
+		break;
+	case FillKernel::AVX2:
+		if (LineAligned(pixels, wh))
+		{
+			FillRows<FillSpanAVX2<true>>(pixels, wh, y0, y1, color);
+			_mm_sfence();
+		}
+		else
+		{
+			FillRows<FillSpanAVX2<false>>(pixels, wh, y0, y1, color);
+		}
+		break;
+#endif
+	default:
+		FillRows<FillSpanScalar>(pixels, wh, y0, y1, color);
+		break;
+	}
+}
+
+void FillChecker(uint32_t* pixels, size_t wh, uint32_t color, ThreadPool* pool, FillKernel kernel)
+{
+	if (pool == nullptr)
+	{
+		FillCheckerRows(pixels, wh, 0, wh, color, kernel);
+		return;
+	}
+	pool->ParallelFor(wh, [=](size_t y0, size_t y1) { FillCheckerRows(pixels, wh, y0, y1, color, kernel); });
+}
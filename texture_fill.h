@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class ThreadPool;
+
+// ------------------------------
+// texture fill: solid colour with a 32x32 grey checker on top, the pattern
+// memset32 + makechecker produce, written in a single pass
+
+// cache line, allocate texture buffers with this alignment
+const size_t kTextureAlignment = 64;
+
+enum class FillKernel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+};
+
+// widest kernel the cpu (and os) supports
+FillKernel	BestFillKernel();
+bool		FillKernelSupported(FillKernel kernel);
+const char*	FillKernelName(FillKernel kernel);
+
+// rows [y0, y1) of a wh x wh RGBA8 image. the simd kernels stream past the caches when
+// pixels is 64 byte aligned and the checker cells are whole cache lines
+void		FillCheckerRows(uint32_t* pixels, size_t wh, size_t y0, size_t y1, uint32_t color, FillKernel kernel);
+
+// the whole image, split into row bands across pool (calling thread only without one)
+void		FillChecker(uint32_t* pixels, size_t wh, uint32_t color, ThreadPool* pool = nullptr, FillKernel kernel = BestFillKernel());
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "glad.h"
+#include "logging.h"
+#include "texture_upload.h"
+
+#include <algorithm>
+
+bool PboUploadRing::Init(size_t slot_size, int slots)
+{
+	Destroy();
+	slots = std::clamp(slots, 1, kMaxSlots);
+
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		// coherent, so texels written through the mapping need no explicit flush before the copy
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &_buffers[0]);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[0]);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slot_size * slots, nullptr, flags);
+		_persistent = (char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slot_size * slots, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (_persistent == nullptr)
+		{
+			LOG(WARNING) << "[" << _instance_name << "] " << "pbo ring: persistent mapping failed, mapping per upload";
+			glDeleteBuffers(1, &_buffers[0]);
+			_buffers[0] = 0;
+		}
+	}
+
+	if (_persistent == nullptr)
+	{
+		glGenBuffers(slots, _buffers);
+		for (int i = 0; i < slots; ++i)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, slot_size, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	if (glGetError() != GL_NO_ERROR)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "pbo ring: can't allocate " << slots << " x " << slot_size / (1024 * 1024) << "mb";
+		Destroy();
+		return false;
+	}
+
+	_slot_size = slot_size;
+	_slots = slots;
+	_current = 0;
+	return true;
+}
+
+void PboUploadRing::Destroy()
+{
+	for (GLsync& fence : _fences)
+	{
+		if (fence) glDeleteSync(fence);
+		fence = 0;
+	}
+	if (_persistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[0]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		_persistent = nullptr;
+	}
+	for (GLuint& buffer : _buffers)
+	{
+		if (buffer) glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	_slots = 0;
+}
+
+void* PboUploadRing::Begin()
+{
+	if (!Valid()) return nullptr;
+
+	// the copy out of this slot was queued _slots uploads ago, normally long done
+	GLsync& fence = _fences[_current];
+	if (fence)
+	{
+		GLenum ret;
+		do
+		{
+			ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);	// 1 s, in ns
+		} while (ret == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if (_persistent)
+	{
+		return _persistent + _current * _slot_size;
+	}
+
+	// nothing reads the slot any more, skip the driver's own synchronization
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[_current]);
+	void* ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, _slot_size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return ptr;
+}
+
+void PboUploadRing::End(GLuint texture, GLsizei wh, GLint layer)
+{
+	if (!Valid()) return;
+
+	size_t offset = 0;
+	if (_persistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[0]);
+		offset = _current * _slot_size;
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffers[_current]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	// with a bound unpack buffer the pointer argument is an offset into it
+	if (layer >= 0)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, wh, wh, 1, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, wh, wh, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	_fences[_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();	// get the copy going while the next slot is filled
+	_current = (_current + 1) % _slots;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "glad.h"
+
+#include <stddef.h>
+
+// ------------------------------
+// pbo upload ring: texels are written into a ring of pixel unpack buffers and
+// copied into the texture by the driver, while the cpu fills the next slot.
+// one persistently mapped buffer when GL_ARB_buffer_storage is there, otherwise
+// a buffer per slot mapped and unmapped around every fill. a fence per slot
+// keeps us from overwriting texels the driver hasn't consumed yet.
+
+class PboUploadRing
+{
+public:
+	// slots of slot_size bytes each, needs a current context
+	bool	Init(size_t slot_size, int slots);
+	// needs the context as well, so it's not left to a destructor
+	void	Destroy();
+
+	bool	Valid() const { return _slots > 0; }
+	bool	Persistent() const { return _persistent != nullptr; }
+
+	// wait until the next slot is free, returns where to write slot_size bytes of texels
+	void*	Begin();
+
+	// upload the slot filled since Begin into level 0 of texture (wh x wh RGBA8), fence it and advance.
+	// with a layer, texture is a 2d array texture and only that layer is written
+	void	End(GLuint texture, GLsizei wh, GLint layer = -1);
+
+private:
+	static const int kMaxSlots = 4;
+
+	size_t		_slot_size = 0;
+	int			_slots = 0;
+	int			_current = 0;
+	GLuint		_buffers[kMaxSlots] = {};	// one buffer (persistent) or one per slot
+	GLsync		_fences[kMaxSlots] = {};
+	char*		_persistent = nullptr;		// mapping of the whole ring in persistent mode
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ------------------------------
+// minimal fork/join pool: ParallelFor splits a range into one chunk per thread,
+// the calling thread works on the first chunk and returns once all chunks are done
+
+class ThreadPool
+{
+public:
+	// threads includes the caller, 0 picks one per hardware thread
+	explicit ThreadPool(size_t threads = 0)
+	{
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 1; i < threads; ++i)
+		{
+			_workers.emplace_back([this, i] { WorkerLoop(i); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_wake.notify_all();
+		for (auto& t : _workers) t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t Size() const { return _workers.size() + 1; }
+
+	// fn(begin, end) for contiguous chunks covering [0, n)
+	void ParallelFor(size_t n, const std::function<void(size_t, size_t)>& fn)
+	{
+		size_t chunks = std::min(Size(), n);
+		if (chunks <= 1)
+		{
+			if (n) fn(0, n);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_job = &fn;
+			_n = n;
+			_chunks = chunks;
+			_remaining = chunks - 1;
+			_generation++;
+		}
+		_wake.notify_all();
+
+		fn(0, n / chunks);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this] { return _remaining == 0; });
+		_job = nullptr;
+	}
+
+private:
+	void WorkerLoop(size_t index)
+	{
+		size_t seen = 0;
+		for (;;)
+		{
+			const std::function<void(size_t, size_t)>* job;
+			size_t n, chunks;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this, seen] { return _quit || _generation != seen; });
+				if (_quit) return;
+				seen = _generation;
+				job = _job;
+				n = _n;
+				chunks = _chunks;
+			}
+
+			// fewer chunks than threads for small ranges, the extra workers sit this one out
+			if (index >= chunks) continue;
+			(*job)(n * index / chunks, n * (index + 1) / chunks);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_remaining == 0) _done.notify_one();
+		}
+	}
+
+	std::vector<std::thread>						_workers;
+	std::mutex										_mutex;
+	std::condition_variable							_wake;
+	std::condition_variable							_done;
+	const std::function<void(size_t, size_t)>*		_job = nullptr;
+	size_t											_n = 0;
+	size_t											_chunks = 0;
+	size_t											_remaining = 0;
+	size_t											_generation = 0;
+	bool											_quit = false;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// steady_clock is CLOCK_MONOTONIC / QueryPerformanceCounter underneath, both are
+// machine wide, so these timestamps can be handed from the master to its children.
+inline int64_t MonotonicNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline double NsToMs(int64_t ns)
+{
+	return ns / 1000000.0;
+}
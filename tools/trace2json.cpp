@@ -0,0 +1,137 @@
+/*
+* converts the binary traces written with --trace into one chrome trace-event json file
+* (chrome://tracing, ui.perfetto.dev), every process on its own track, all of them on
+* the timeline of the earliest span.
+*
+*	trace2json <out.json> <logs/trace.<session>.*.bin>...
+* */
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+struct ProcessTrace
+{
+	TraceHeader					header;
+	std::map<uint16_t, std::string>	names;
+	std::vector<TraceSpan>		spans;
+};
+
+// a file cut short by a kill ends after its last complete record
+static bool ReadTrace(const char* path, ProcessTrace& trace)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "can't open %s\n", path);
+		return false;
+	}
+	if (fread(&trace.header, sizeof(trace.header), 1, file) != 1 || trace.header.magic != kTraceMagic || trace.header.version != kTraceVersion)
+	{
+		fprintf(stderr, "%s is not a trace of this version\n", path);
+		fclose(file);
+		return false;
+	}
+	trace.header.name[sizeof(trace.header.name) - 1] = 0;
+
+	uint8_t type;
+	while (fread(&type, 1, 1, file) == 1)
+	{
+		if (type == TraceRecordName)
+		{
+			TraceName name = {};
+			name.type = type;
+			char text[256];
+			if (fread((char*)&name + 1, sizeof(name) - 1, 1, file) != 1 || fread(text, 1, name.length, file) != name.length) break;
+			trace.names[name.id] = std::string(text, name.length);
+		}
+		else if (type == TraceRecordSpan)
+		{
+			TraceSpan span = {};
+			span.type = type;
+			if (fread((char*)&span + 1, sizeof(span) - 1, 1, file) != 1) break;
+			trace.spans.push_back(span);
+		}
+		else
+		{
+			fprintf(stderr, "%s: unknown record %d, the rest is skipped\n", path, type);
+			break;
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+// names are string literals from our own code, only quotes and backslashes need care
+static std::string Quoted(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\') quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: trace2json <out.json> <trace.bin>...\n");
+		return -1;
+	}
+
+	std::vector<ProcessTrace> traces;
+	for (int i = 2; i < argc; ++i)
+	{
+		ProcessTrace trace;
+		if (ReadTrace(argv[i], trace)) traces.push_back(std::move(trace));
+	}
+
+	int64_t origin_ns = INT64_MAX;
+	size_t spans = 0;
+	for (const ProcessTrace& trace : traces)
+	{
+		for (const TraceSpan& span : trace.spans) origin_ns = std::min(origin_ns, span.start_ns);
+		spans += trace.spans.size();
+	}
+
+	FILE* out = fopen(argv[1], "w");
+	if (out == nullptr)
+	{
+		fprintf(stderr, "can't write %s\n", argv[1]);
+		return -1;
+	}
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const ProcessTrace& trace : traces)
+	{
+		// the master on top, children by slot below it
+		const TraceHeader& h = trace.header;
+		std::string label = std::string(h.name) + " (pid " + std::to_string(h.pid) + ")";
+		fprintf(out, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":%s}}", first ? "" : ",\n", h.pid, Quoted(label).c_str());
+		fprintf(out, ",\n{\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":%d,\"args\":{\"sort_index\":%d}}", h.pid, h.slot);
+		first = false;
+
+		for (const TraceSpan& span : trace.spans)
+		{
+			auto name = trace.names.find(span.name);
+			fprintf(out, ",\n{\"ph\":\"X\",\"name\":%s,\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				Quoted(name != trace.names.end() ? name->second : "?").c_str(), h.pid, span.thread,
+				(span.start_ns - origin_ns) / 1e3, span.duration_ns / 1e3);
+			if (span.arg >= 0) fprintf(out, ",\"args\":{\"arg\":%d}", span.arg);
+			fprintf(out, "}");
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+
+	printf("%zu processes, %zu spans written to %s\n", traces.size(), spans, argv[1]);
+	return 0;
+}
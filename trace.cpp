@@ -0,0 +1,104 @@
+#include "stdafx.h"
+#include "logging.h"
+#include "settings.h"
+#include "timing.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static std::mutex							_mutex;
+static FILE*								_file = nullptr;
+static std::atomic<bool>					_tracing(false);
+static std::unordered_map<const char*, uint16_t>	_names;
+static std::atomic<int>						_threads(0);
+
+static int ThisProcessId()
+{
+#ifdef _WIN32
+	return (int)::GetCurrentProcessId();
+#else
+	return (int)::getpid();
+#endif
+}
+
+static uint8_t ThisThread()
+{
+	thread_local int thread = _threads.fetch_add(1);
+	return (uint8_t)std::min(thread, 255);
+}
+
+bool StartTrace(int session, const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file) return true;
+
+	std::error_code ec;
+	std::filesystem::create_directories("logs", ec);
+	std::filesystem::path path = std::filesystem::path("logs") / ("trace." + std::to_string(session) + "." + name + "." + std::to_string(ThisProcessId()) + ".bin");
+	_file = fopen(path.string().c_str(), "wb");
+	if (_file == nullptr)
+	{
+		LOG(ERROR) << "[" << _instance_name << "] " << "trace: can't open " << path.string();
+		return false;
+	}
+
+	TraceHeader header = { kTraceMagic, kTraceVersion, ThisProcessId(), kInstance_slot, {} };
+	strncpy(header.name, name.c_str(), sizeof(header.name) - 1);
+	fwrite(&header, sizeof(header), 1, _file);
+	fflush(_file);
+	_names.clear();
+	_tracing.store(true);
+	return true;
+}
+
+void StopTrace()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_tracing.store(false);
+	if (_file) fclose(_file);
+	_file = nullptr;
+}
+
+void TraceEvent(const char* name, int64_t start_ns, int64_t end_ns, int arg)
+{
+	if (!_tracing.load(std::memory_order_relaxed)) return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file == nullptr) return;
+
+	auto it = _names.find(name);
+	if (it == _names.end())
+	{
+		size_t length = std::min<size_t>(strlen(name), 255);
+		TraceName record = { TraceRecordName, (uint8_t)length, (uint16_t)_names.size() };
+		fwrite(&record, sizeof(record), 1, _file);
+		fwrite(name, 1, length, _file);
+		it = _names.emplace(name, record.id).first;
+	}
+
+	TraceSpan span = { TraceRecordSpan, ThisThread(), it->second, arg, start_ns, end_ns - start_ns };
+	fwrite(&span, sizeof(span), 1, _file);
+	fflush(_file);
+}
+
+TraceScope::TraceScope(const char* name, int arg)
+	: _name(name)
+	, _arg(arg)
+	, _start_ns(_tracing.load(std::memory_order_relaxed) ? MonotonicNs() : 0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+	if (_start_ns != 0) TraceEvent(_name, _start_ns, MonotonicNs(), _arg);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// ------------------------------
+// event trace (--trace): every process writes the spans of its startup phases and,
+// in the master, of every spawn and kill into logs/trace.<session>.<name>.<pid>.bin.
+// spans are written (and flushed) as they end, a child killed outright keeps
+// everything up to its last finished span. timestamps are MonotonicNs(), machine
+// wide, so tools/trace2json can put all files of a session on one timeline.
+
+// file layout: a TraceHeader, then records. a name record introduces the id spans
+// refer to, it's written before the first span using it.
+const uint32_t	kTraceMagic = 0x52544f4f;	// "OOTR"
+const uint32_t	kTraceVersion = 1;
+
+struct TraceHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	int32_t		pid;
+	int32_t		slot;		// -1 for the master
+	char		name[32];	// the instance name
+};
+
+enum TraceRecordType : uint8_t
+{
+	TraceRecordName = 1,	// TraceName, then length chars
+	TraceRecordSpan = 2,	// TraceSpan
+};
+
+struct TraceName
+{
+	uint8_t		type;
+	uint8_t		length;
+	uint16_t	id;
+};
+
+struct TraceSpan
+{
+	uint8_t		type;
+	uint8_t		thread;		// per process, in order of the first span on it
+	uint16_t	name;
+	int32_t		arg;		// slot or texture, -1 for none
+	int64_t		start_ns;
+	int64_t		duration_ns;
+};
+static_assert(sizeof(TraceSpan) == 24, "TraceSpan is written as is");
+
+// open the trace file of this process, session is the master's process id
+bool	StartTrace(int session, const std::string& name);
+void	StopTrace();
+
+// a span from start_ns to end_ns, name has to be a string literal (it's interned by address)
+void	TraceEvent(const char* name, int64_t start_ns, int64_t end_ns, int arg = -1);
+
+// a span over the lifetime of the scope, does nothing while no trace is open
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name, int arg = -1);
+	~TraceScope();
+
+	void	SetArg(int arg) { _arg = arg; }
+
+private:
+	const char*	_name;
+	int			_arg;
+	int64_t		_start_ns;
+};